@@ -0,0 +1,36 @@
+#ifndef COMPRESSEDSIZE_H
+#define COMPRESSEDSIZE_H
+
+#include <lz4.h>
+#include <vector>
+#include <cstddef>
+
+namespace DVIDUtils {
+
+/*!
+ * Size of a buffer after lz4 compression, the encoding libdvid
+ * uses when compression is enabled.  This compresses the buffer, so
+ * it is only applied to samples (see WireBytes.h).  Large buffers
+ * are measured in pieces that fit lz4's input limit.
+ * \param data buffer
+ * \param size buffer size in bytes
+ * \return compressed size in bytes
+*/
+inline unsigned long long lz4_compressed_size(const char* data, size_t size)
+{
+    const size_t max_piece = 1 << 30;
+    std::vector<char> scratch;
+    unsigned long long compressed = 0;
+
+    for (size_t pos = 0; pos < size; pos += max_piece) {
+        int piece = (int) ((size - pos < max_piece) ? (size - pos) : max_piece);
+        scratch.resize(LZ4_compressBound(piece));
+        compressed += LZ4_compress_default(data + pos, &scratch[0], piece,
+                (int) scratch.size());
+    }
+    return compressed;
+}
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MORTONCODE_H
+#define MORTONCODE_H
+
+namespace DVIDUtils {
+
+//! bits per coordinate in a 64 bit Morton code
+static const int MORTON_BITS = 21;
+
+/*!
+ * Spread the low 21 bits of a value so there are two zero bits
+ * between each.
+*/
+inline unsigned long long morton_spread(unsigned long long val)
+{
+    val &= (1ULL << MORTON_BITS) - 1;
+    val = (val | (val << 32)) & 0x1f00000000ffffULL;
+    val = (val | (val << 16)) & 0x1f0000ff0000ffULL;
+    val = (val | (val << 8)) & 0x100f00f00f00f00fULL;
+    val = (val | (val << 4)) & 0x10c30c30c30c30c3ULL;
+    val = (val | (val << 2)) & 0x1249249249249249ULL;
+    return val;
+}
+
+/*!
+ * Z-order (Morton) code interleaving the low 21 bits of each
+ * coordinate; sorting by it keeps nearby points close together.
+*/
+inline unsigned long long morton_code(unsigned long long x, unsigned long long y,
+        unsigned long long z)
+{
+    return morton_spread(x) | (morton_spread(y) << 1) | (morton_spread(z) << 2);
+}
+
+}
+
+#endif
@@ -7,13 +7,15 @@
 #include <string>
 #include <vector>
 #include <iomanip>
+#include <cassert>
+#include <cstdlib>
 
-namespace DVIDViewer {
+namespace DVIDUtils {
 class OptionParser
 {
   public:
-    OptionParser(std::string description_) : description(description_), 
-        generic_options("Options"), hidden_options("Hidden Options")
+    OptionParser(std::string description_) : generic_options("Options"),
+        hidden_options("Hidden Options"), description(description_)
     {
         generic_options.add_options()
             ("help,h", "Show help message");
@@ -40,11 +42,18 @@ class OptionParser
         }
     }
 
-    void add_positional(std::string& var_ref, std::string identifier, std::string description)
+    void add_positional(std::string& var_ref, std::string identifier, std::string description,
+            bool required=true)
     {
-        hidden_options.add_options()
-            (identifier.c_str(), boost::program_options::value<std::string>(&var_ref)->required(),
-             description.c_str());
+        if (required) {
+            hidden_options.add_options()
+                (identifier.c_str(), boost::program_options::value<std::string>(&var_ref)->required(),
+                 description.c_str());
+        } else {
+            hidden_options.add_options()
+                (identifier.c_str(), boost::program_options::value<std::string>(&var_ref),
+                 description.c_str());
+        }
         positional_options.add(identifier.c_str(), 1);
         positional_ids.push_back(identifier);
         positional_descr.push_back(description);
@@ -82,6 +91,13 @@ class OptionParser
     } 
 
 
+    void add_flag(bool& var_ref, std::string identifier, std::string description)
+    {
+        generic_options.add_options()
+            (identifier.c_str(), boost::program_options::bool_switch(&var_ref),
+             description.c_str());
+    }
+
   private:
     void print_help()
     {
@@ -0,0 +1,94 @@
+/*!
+ * Counts bytes transferred to and from DVID.  Buffers sent or
+ * received as is are counted exactly.  libdvid does not report the
+ * size of lz4 compressed transfers, so these are estimated: one
+ * buffer in WIRE_SAMPLE_INTERVAL is compressed again locally and the
+ * sampled ratio is applied to the rest.  HTTP framing is not counted.
+*/
+
+#ifndef WIREBYTES_H
+#define WIREBYTES_H
+
+#include "CompressedSize.h"
+
+#include <ostream>
+#include <cstddef>
+
+namespace DVIDUtils {
+
+//! compressed transfers per locally compressed sample
+static const unsigned long long WIRE_SAMPLE_INTERVAL = 64;
+
+struct WireBytes {
+    WireBytes() : plain(0), compressed(0), transfers(0), samples(0), sampled(0),
+        sampled_wire(0) {}
+
+    //! bytes sent or received as is
+    unsigned long long plain;
+    //! uncompressed size of buffers transferred lz4 compressed
+    unsigned long long compressed;
+    //! number of compressed transfers
+    unsigned long long transfers;
+    //! buffers sampled, with their uncompressed and lz4 size
+    unsigned long long samples;
+    unsigned long long sampled;
+    unsigned long long sampled_wire;
+
+    /*!
+     * Count a transferred buffer.
+     * \param data buffer contents (only read when sampled)
+     * \param size buffer size in bytes
+     * \param compress whether libdvid lz4 compressed the transfer
+    */
+    void add(const char* data, size_t size, bool compress)
+    {
+        if (!compress) {
+            plain += size;
+            return;
+        }
+        if (transfers++ % WIRE_SAMPLE_INTERVAL == 0) {
+            ++samples;
+            sampled += size;
+            sampled_wire += lz4_compressed_size(data, size);
+        }
+        compressed += size;
+    }
+
+    void merge(const WireBytes& other)
+    {
+        plain += other.plain;
+        compressed += other.compressed;
+        transfers += other.transfers;
+        samples += other.samples;
+        sampled += other.sampled;
+        sampled_wire += other.sampled_wire;
+    }
+
+    //! true if part of the total is estimated
+    bool estimated() const
+    {
+        return compressed != 0;
+    }
+
+    //! exact plain bytes plus the estimate for compressed transfers
+    unsigned long long total() const
+    {
+        if (sampled == 0) {
+            return plain;
+        }
+        return plain + (unsigned long long) (double(compressed) * sampled_wire / sampled);
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << total();
+        if (estimated()) {
+            os << ", lz4 estimate from " << samples << " of " << transfers
+                << " compressed transfers";
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*!
+ * Thread-safe FIFO used to hand work between pipeline stages.
+ * Closing the queue wakes all waiting consumers.
+*/
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+
+namespace DVIDUtils {
+
+template <typename T>
+class WorkQueue {
+  public:
+    WorkQueue() : closed(false) {}
+
+    void push(const T& item)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        items.push_back(item);
+        not_empty.notify_one();
+    }
+
+    /*!
+     * Wait for the next item.
+     * \param item filled with next item
+     * \return false if the queue was closed and is empty
+    */
+    bool pop(T& item)
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        while (items.empty() && !closed) {
+            not_empty.wait(lock);
+        }
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    void close()
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+    //! accept items again after close (once consumers have exited)
+    void reopen()
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        closed = false;
+    }
+
+  private:
+    std::deque<T> items;
+    bool closed;
+    boost::mutex mutex;
+    boost::condition_variable not_empty;
+};
+
+}
+
+#endif
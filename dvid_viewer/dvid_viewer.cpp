@@ -20,6 +20,7 @@
 #include <libdvid/DVIDNodeService.h>
 
 using namespace DVIDViewer;
+using DVIDUtils::OptionParser;
 using std::string;
 using std::cout; using std::cerr; using std::endl;
 using std::vector;
@@ -0,0 +1,123 @@
+#include "BlockRoi.h"
+#include "ChunkLoader.h"
+
+#include <json/json.h>
+#include <json/value.h>
+#include <fstream>
+#include <algorithm>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::tr1::unordered_map;
+
+namespace DVIDLoadSparse {
+
+void BlockRoi::add_span(int bz, int by, int bx1, int bx2)
+{
+    rows[row_key(by, bz)].push_back(std::make_pair(bx1, bx2));
+}
+
+bool BlockRoi::load_file(string filename, string& error)
+{
+    std::ifstream fin(filename.c_str());
+    if (!fin) {
+        error = "cannot be opened";
+        return false;
+    }
+    Json::Reader json_reader;
+    Json::Value spans;
+    if (!json_reader.parse(fin, spans) || !spans.isArray()) {
+        error = "expected a JSON array of [z, y, x0, x1] spans";
+        return false;
+    }
+    for (unsigned int i = 0; i < spans.size(); ++i) {
+        const Json::Value& span = spans[i];
+        if (!span.isArray() || span.size() != 4 || span[2u].asInt() > span[3u].asInt()) {
+            error = "expected a JSON array of [z, y, x0, x1] spans";
+            return false;
+        }
+        add_span(span[0u].asInt(), span[1u].asInt(), span[2u].asInt(), span[3u].asInt());
+    }
+    return true;
+}
+
+void BlockRoi::finalize()
+{
+    num_blocks = 0;
+    for (unordered_map<unsigned long long, vector<pair<int, int> > >::iterator iter =
+            rows.begin(); iter != rows.end(); ++iter) {
+        vector<pair<int, int> >& spans = iter->second;
+        std::sort(spans.begin(), spans.end());
+
+        // merge overlapping and adjacent spans
+        size_t merged = 0;
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if (merged > 0 && spans[i].first <= spans[merged-1].second + 1) {
+                spans[merged-1].second = std::max(spans[merged-1].second, spans[i].second);
+            } else {
+                spans[merged++] = spans[i];
+            }
+        }
+        spans.resize(merged);
+
+        // count after merging so repeated blocks are counted once
+        for (size_t i = 0; i < spans.size(); ++i) {
+            num_blocks += spans[i].second - spans[i].first + 1;
+        }
+    }
+}
+
+void BlockRoi::get_spans(vector<int>& spans) const
+{
+    // rows are hashed, so order them by row key
+    vector<pair<unsigned long long, const vector<pair<int, int> >*> > sorted_rows;
+    for (unordered_map<unsigned long long, vector<pair<int, int> > >::const_iterator iter =
+            rows.begin(); iter != rows.end(); ++iter) {
+        sorted_rows.push_back(std::make_pair(iter->first, &iter->second));
+    }
+    std::sort(sorted_rows.begin(), sorted_rows.end());
+
+    spans.clear();
+    for (size_t i = 0; i < sorted_rows.size(); ++i) {
+        const vector<pair<int, int> >& row = *sorted_rows[i].second;
+        for (size_t j = 0; j < row.size(); ++j) {
+            spans.push_back((int) (sorted_rows[i].first >> 32));
+            spans.push_back((int) (unsigned int) sorted_rows[i].first);
+            spans.push_back(row[j].first);
+            spans.push_back(row[j].second);
+        }
+    }
+}
+
+void BlockRoi::clip_row(int z, int y, const vector<Segment>& row,
+        vector<Segment>& clipped) const
+{
+    clipped.clear();
+    unordered_map<unsigned long long, vector<pair<int, int> > >::const_iterator iter =
+        rows.find(row_key(floor_div(y, block_size), floor_div(z, block_size)));
+    if (iter == rows.end()) {
+        return;
+    }
+    const vector<pair<int, int> >& spans = iter->second;
+
+    // both lists are sorted, so walk them together
+    size_t span = 0;
+    for (size_t i = 0; i < row.size(); ++i) {
+        while (span < spans.size() &&
+                (spans[span].second + 1) * (long long) block_size <= row[i].x1) {
+            ++span;
+        }
+        for (size_t j = span; j < spans.size() &&
+                spans[j].first * (long long) block_size <= row[i].x2; ++j) {
+            Segment segment;
+            segment.x1 = std::max((long long) row[i].x1,
+                    spans[j].first * (long long) block_size);
+            segment.x2 = std::min((long long) row[i].x2,
+                    (spans[j].second + 1) * (long long) block_size - 1);
+            clipped.push_back(segment);
+        }
+    }
+}
+
+}
@@ -0,0 +1,79 @@
+/*!
+ * Region of interest made of DVID blocks, used to clip sparse
+ * volumes before any labels are fetched.  Blocks are kept as sorted
+ * runs along x for each (y, z) block row, the same spans DVID uses
+ * for ROIs.
+*/
+
+#ifndef BLOCKROI_H
+#define BLOCKROI_H
+
+#include "SparseVolume.h"
+
+#include <tr1/unordered_map>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+class BlockRoi {
+  public:
+    /*!
+     * \param block_size_ size of a ROI block in voxels
+    */
+    BlockRoi(int block_size_) : block_size(block_size_), num_blocks(0) {}
+
+    //! add a block (block coordinates)
+    void add_block(int bx, int by, int bz)
+    {
+        add_span(bz, by, bx, bx);
+    }
+
+    //! add blocks bx1 to bx2 (inclusive) of a block row
+    void add_span(int bz, int by, int bx1, int bx2);
+
+    /*!
+     * Read a DVID ROI span file: a JSON array of [z, y, x0, x1]
+     * block spans as returned by the ROI endpoint.
+     * \return false if the file cannot be read or is malformed
+    */
+    bool load_file(std::string filename, std::string& error);
+
+    //! sort and merge spans (call after adding blocks)
+    void finalize();
+
+    /*!
+     * Intersect sorted, disjoint segments of voxel row (z, y) with
+     * the ROI.
+     * \param row segments of the row
+     * \param clipped parts of the segments inside the ROI
+    */
+    void clip_row(int z, int y, const std::vector<Segment>& row,
+            std::vector<Segment>& clipped) const;
+
+    //! merged spans as z, y, x1, x2 (block coordinates) in a fixed order
+    void get_spans(std::vector<int>& spans) const;
+
+    //! distinct blocks in the ROI (after finalize)
+    unsigned long long get_num_blocks() const
+    {
+        return num_blocks;
+    }
+
+  private:
+    static unsigned long long row_key(int by, int bz)
+    {
+        return ((unsigned long long) (unsigned int) bz << 32) | (unsigned int) by;
+    }
+
+    int block_size;
+    unsigned long long num_blocks;
+
+    //! x block runs (inclusive) of each (y, z) block row
+    std::tr1::unordered_map<unsigned long long,
+        std::vector<std::pair<int, int> > > rows;
+};
+
+}
+
+#endif
@@ -0,0 +1,256 @@
+#include "ChunkLoader.h"
+#include "FillKernel.h"
+
+#include <algorithm>
+
+using std::vector;
+using std::string;
+
+namespace DVIDLoadSparse {
+
+// number of DVID blocks intersected by the inclusive box
+static unsigned long long num_blocks(int x1, int y1, int z1,
+        int x2, int y2, int z2, int block_size)
+{
+    return (unsigned long long)(floor_div(x2, block_size) - floor_div(x1, block_size) + 1) *
+        (floor_div(y2, block_size) - floor_div(y1, block_size) + 1) *
+        (floor_div(z2, block_size) - floor_div(z1, block_size) + 1);
+}
+
+void plan_chunks(const SparseVolume& volume, int block_size,
+        int chunk_depth, vector<Chunk>& chunks, LoadStats& stats)
+{
+    // planes are sorted by z so each slab is a contiguous plane range
+    for (size_t plane = 0; plane < volume.num_planes(); ++plane) {
+        int z = volume.get_plane_z(plane);
+        int minx, miny, maxx, maxy;
+        volume.plane_bounds(plane, minx, miny, maxx, maxy);
+
+        // cost of fetching and posting only this plane
+        stats.baseline_requests += 2;
+        stats.baseline_bytes += 2 * sizeof(unsigned long long) *
+            (unsigned long long)(maxx - minx + 1) * (maxy - miny + 1);
+        stats.baseline_block_writes += num_blocks(minx, miny, z, maxx, maxy, z, block_size);
+
+        bool new_slab = chunks.empty() || (chunk_depth <= 1) ||
+            (floor_div(z, chunk_depth) != floor_div(chunks.back().z1, chunk_depth));
+        if (new_slab) {
+            Chunk chunk;
+            chunk.x1 = minx; chunk.y1 = miny; chunk.z1 = z;
+            chunk.x2 = maxx; chunk.y2 = maxy; chunk.z2 = z;
+            chunk.plane_begin = plane;
+            chunks.push_back(chunk);
+        } else {
+            Chunk& chunk = chunks.back();
+            chunk.x1 = std::min(chunk.x1, minx); chunk.x2 = std::max(chunk.x2, maxx);
+            chunk.y1 = std::min(chunk.y1, miny); chunk.y2 = std::max(chunk.y2, maxy);
+            chunk.z2 = z;
+        }
+        chunks.back().plane_end = plane + 1;
+    }
+
+    // snap to block boundaries (chunk_depth is a multiple of the
+    // block size so z stays inside the slab)
+    if (chunk_depth > 1) {
+        for (unsigned int i = 0; i < chunks.size(); ++i) {
+            Chunk& chunk = chunks[i];
+            chunk.x1 = align_down(chunk.x1, block_size);
+            chunk.y1 = align_down(chunk.y1, block_size);
+            chunk.z1 = align_down(chunk.z1, block_size);
+            chunk.x2 = align_up(chunk.x2, block_size);
+            chunk.y2 = align_up(chunk.y2, block_size);
+            chunk.z2 = align_up(chunk.z2, block_size);
+        }
+    }
+}
+
+bool chunks_share_block(const Chunk& chunk1, const Chunk& chunk2, int block_size)
+{
+    return (floor_div(chunk1.x1, block_size) <= floor_div(chunk2.x2, block_size)) &&
+        (floor_div(chunk2.x1, block_size) <= floor_div(chunk1.x2, block_size)) &&
+        (floor_div(chunk1.y1, block_size) <= floor_div(chunk2.y2, block_size)) &&
+        (floor_div(chunk2.y1, block_size) <= floor_div(chunk1.y2, block_size)) &&
+        (floor_div(chunk1.z1, block_size) <= floor_div(chunk2.z2, block_size)) &&
+        (floor_div(chunk2.z1, block_size) <= floor_div(chunk1.z2, block_size));
+}
+
+// start point of a chunk (X, Y, Z)
+static vector<unsigned int> chunk_start(const Chunk& chunk)
+{
+    vector<unsigned int> start; start.push_back(chunk.x1);
+    start.push_back(chunk.y1); start.push_back(chunk.z1);
+    return start;
+}
+
+libdvid::Labels3D ChunkLoader::fetch_chunk(libdvid::DVIDNodeService& dvid_node,
+        const Chunk& chunk, LoadStats& stats) const
+{
+    // create dvid size (X, Y, Z)
+    libdvid::Dims_t sizes; sizes.push_back(chunk.width());
+    sizes.push_back(chunk.height()); sizes.push_back(chunk.depth());
+
+    if (chunk.write_only) {
+        vector<unsigned long long> body_data(chunk.volume(), 0);
+        stats.write_only_chunks += 1;
+        stats.fetch_bytes_avoided += sizeof(unsigned long long) * chunk.volume();
+        return libdvid::Labels3D(&body_data[0],
+                sizeof(unsigned long long) * chunk.volume(), sizes);
+    }
+
+    // retrieve dvid subvolume
+    libdvid::Labels3D labels = dvid_node.get_labels3D(label_name, sizes,
+            chunk_start(chunk), compress);
+
+    unsigned long long size = sizeof(unsigned long long) * chunk.volume();
+    stats.requests += 1;
+    stats.bytes += size;
+    stats.wire.add((const char*) labels.get_raw(), size, compress);
+    return labels;
+}
+
+void ChunkLoader::record_undo(const SparseVolume& volume, const Chunk& chunk,
+        const unsigned long long* ldata_raw) const
+{
+    unsigned long long width = chunk.width();
+    unsigned long long plane_size = width * chunk.height();
+    vector<char> records;
+    vector<UndoRun> runs;
+    unsigned long long num_runs = 0;
+
+    // all bodies are recorded before any is written so that overlapping
+    // bodies record the original label
+    for (size_t plane = chunk.plane_begin; plane != chunk.plane_end; ++plane) {
+        unsigned long long zoffset = (volume.get_plane_z(plane) - chunk.z1) * plane_size;
+
+        for (size_t s = volume.row_lower_bound(plane, chunk.y1);
+                s != volume.plane_end(plane); ++s) {
+            const Stripe& stripe = volume.get_stripe(s);
+            if (stripe.y > chunk.y2) {
+                break;
+            }
+            const unsigned long long* row = ldata_raw + zoffset +
+                (stripe.y - chunk.y1) * width;
+            runs.clear();
+            for (unsigned int i = 0; i < stripe.num_segments; ++i) {
+                int x1 = std::max(stripe.segments[i].x1, chunk.x1);
+                int x2 = std::min(stripe.segments[i].x2, chunk.x2);
+                if (x1 > x2) {
+                    continue;
+                }
+                UndoRun run;
+                run.x1 = x1;
+                run.label = row[x1 - chunk.x1];
+                for (int x = x1 + 1; x <= x2; ++x) {
+                    if (row[x - chunk.x1] != run.label) {
+                        run.x2 = x - 1;
+                        runs.push_back(run);
+                        run.x1 = x;
+                        run.label = row[x - chunk.x1];
+                    }
+                }
+                run.x2 = x2;
+                runs.push_back(run);
+            }
+            if (!runs.empty()) {
+                UndoSnapshot::add_row(records, stripe.z, stripe.y, runs);
+                num_runs += runs.size();
+            }
+        }
+    }
+    if (!records.empty()) {
+        snapshot->append(records, num_runs);
+    }
+}
+
+bool ChunkLoader::relabel_chunk(const SparseVolume& volume, const Chunk& chunk,
+        libdvid::Labels3D& labels, LoadStats& stats) const
+{
+    unsigned long long voxels = 0;
+    unsigned long long changed = 0;
+
+    unsigned long long* ldata_raw = (unsigned long long*) labels.get_raw();
+    if (snapshot) {
+        record_undo(volume, chunk, ldata_raw);
+    }
+    unsigned long long width = chunk.width();
+    unsigned long long plane_size = width * chunk.height();
+
+    // with several bodies, conditions are checked against the labels
+    // as fetched so the result does not depend on the body order
+    vector<unsigned long long> original;
+    if (condition.conditional && volume.num_bodies() > 1) {
+        original.assign(ldata_raw, ldata_raw + chunk.volume());
+    }
+
+    // rewrite body id in label data (segments are clipped to the chunk
+    // since a tile may cover only part of a plane)
+    for (size_t plane = chunk.plane_begin; plane != chunk.plane_end; ++plane) {
+        unsigned long long zoffset = (volume.get_plane_z(plane) - chunk.z1) * plane_size;
+
+        for (size_t s = volume.row_lower_bound(plane, chunk.y1);
+                s != volume.plane_end(plane); ++s) {
+            const Stripe& stripe = volume.get_stripe(s);
+            if (stripe.y > chunk.y2) {
+                break;
+            }
+            unsigned long long new_body_id = volume.get_body_id(stripe.body);
+            unsigned long long offset = zoffset + (stripe.y - chunk.y1) * width;
+            for (unsigned int i = 0; i < stripe.num_segments; ++i) {
+                int x1 = std::max(stripe.segments[i].x1, chunk.x1);
+                int x2 = std::min(stripe.segments[i].x2, chunk.x2);
+                if (x1 > x2) {
+                    continue;
+                }
+                if (!original.empty()) {
+                    changed += replace_labels_where(ldata_raw + offset + (x1 - chunk.x1),
+                            &original[offset + (x1 - chunk.x1)], x2 - x1 + 1,
+                            condition.label1, condition.label2, new_body_id);
+                    voxels += x2 - x1 + 1;
+                } else if (condition.conditional) {
+                    changed += replace_labels(ldata_raw + offset + (x1 - chunk.x1),
+                            x2 - x1 + 1, condition.label1, condition.label2, new_body_id);
+                    voxels += x2 - x1 + 1;
+                } else {
+                    fill_labels(ldata_raw + offset + (x1 - chunk.x1), x2 - x1 + 1,
+                            new_body_id);
+                }
+            }
+        }
+    }
+
+    if (!condition.conditional) {
+        return true;
+    }
+    stats.voxels_changed += changed;
+    stats.voxels_skipped += voxels - changed;
+    if (changed == 0) {
+        stats.unchanged_chunks += 1;
+        return false;
+    }
+    return true;
+}
+
+void ChunkLoader::write_chunk(libdvid::DVIDNodeService& dvid_node, const Chunk& chunk,
+        libdvid::Labels3D& labels, LoadStats& stats) const
+{
+    // the fetched buffer was relabeled in place so it can be posted as is
+    dvid_node.put_labels3D(label_name, labels, chunk_start(chunk), compress);
+
+    unsigned long long size = sizeof(unsigned long long) * chunk.volume();
+    stats.requests += 1;
+    stats.bytes += size;
+    stats.wire.add((const char*) labels.get_raw(), size, compress);
+    stats.block_writes += num_blocks(chunk.x1, chunk.y1, chunk.z1,
+            chunk.x2, chunk.y2, chunk.z2, block_size);
+}
+
+void ChunkLoader::load_chunk(libdvid::DVIDNodeService& dvid_node,
+        const SparseVolume& volume, const Chunk& chunk, LoadStats& stats) const
+{
+    libdvid::Labels3D labels = fetch_chunk(dvid_node, chunk, stats);
+    if (relabel_chunk(volume, chunk, labels, stats)) {
+        write_chunk(dvid_node, chunk, labels, stats);
+    }
+}
+
+}
@@ -0,0 +1,160 @@
+/*!
+ * Groups the planes of a sparse volume into subvolumes (chunks)
+ * and relabels each chunk with a single read-modify-write.
+*/
+
+#ifndef CHUNKLOADER_H
+#define CHUNKLOADER_H
+
+#include "SparseVolume.h"
+#include "LoadStats.h"
+#include "UndoSnapshot.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+// floor division and alignment that behave for negative coordinates
+inline int floor_div(int val, int div)
+{
+    return (val >= 0) ? (val / div) : -((-val + div - 1) / div);
+}
+
+inline int align_down(int val, int align)
+{
+    return floor_div(val, align) * align;
+}
+
+inline int align_up(int val, int align)
+{
+    return align_down(val, align) + align - 1;
+}
+
+/*!
+ * Subvolume fetched and written in one request each.  Bounds
+ * are inclusive.
+*/
+struct Chunk {
+    Chunk() : x1(0), y1(0), z1(0), x2(0), y2(0), z2(0),
+        plane_begin(0), plane_end(0), write_only(false), id(0) {}
+
+    int x1, y1, z1;
+    int x2, y2, z2;
+
+    //! planes of the sparse volume in the chunk are [plane_begin, plane_end)
+    size_t plane_begin, plane_end;
+
+    //! every voxel is covered by the body so the chunk is not fetched
+    bool write_only;
+
+    //! position in the full load plan (used by the journal)
+    size_t id;
+
+    unsigned long long width() const { return x2 - x1 + 1; }
+    unsigned long long height() const { return y2 - y1 + 1; }
+    unsigned long long depth() const { return z2 - z1 + 1; }
+    unsigned long long volume() const { return width() * height() * depth(); }
+};
+
+/*!
+ * Partition the sparse volume into chunks.  A chunk depth of 1
+ * produces one chunk per plane sized to the plane's bounding box.
+ * Otherwise, planes are grouped into z slabs chunk_depth deep and
+ * each chunk is expanded to DVID block boundaries so that every
+ * block is written at most once.
+ * \param volume sparse volume
+ * \param block_size DVID block size
+ * \param chunk_depth z depth of a chunk (multiple of block_size or 1)
+ * \param chunks chunks sorted by z
+ * \param stats baseline (per-plane) costs are added here
+*/
+void plan_chunks(const SparseVolume& volume, int block_size,
+        int chunk_depth, std::vector<Chunk>& chunks, LoadStats& stats);
+
+/*!
+ * True if the chunks touch a common DVID block.  Writes to the same
+ * block are not atomic on the server, so such chunks must be
+ * written one after the other.
+*/
+bool chunks_share_block(const Chunk& chunk1, const Chunk& chunk2, int block_size);
+
+/*!
+ * Voxels a body may overwrite.  By default every voxel of the body
+ * is written; a conditional overwrite only changes voxels that
+ * held label1 or label2 before the load, whichever manifest bodies
+ * are written over them first.
+*/
+struct OverwriteCondition {
+    OverwriteCondition() : conditional(false), label1(0), label2(0) {}
+
+    bool conditional;
+    unsigned long long label1, label2;
+};
+
+/*!
+ * Read-modify-write of a chunk split into fetch, relabel, and write
+ * stages so that the stages can run on different threads.  The
+ * connection is passed in since a DVIDNodeService cannot be shared
+ * between threads.
+*/
+class ChunkLoader {
+  public:
+    /*!
+     * \param label_name_ name of the label volume
+     * \param block_size_ DVID block size
+     * \param compress_ transfer labels lz4 compressed
+     * \param condition_ voxels the bodies may overwrite
+     * \param snapshot_ records the labels being overwritten (optional)
+    */
+    ChunkLoader(std::string label_name_, int block_size_, bool compress_,
+            OverwriteCondition condition_ = OverwriteCondition(),
+            UndoSnapshot* snapshot_ = 0) :
+        label_name(label_name_), block_size(block_size_), compress(compress_),
+        condition(condition_), snapshot(snapshot_) {}
+
+    //! retrieve the labels of the chunk (write-only chunks are
+    //! allocated locally since relabeling overwrites every voxel)
+    libdvid::Labels3D fetch_chunk(libdvid::DVIDNodeService& dvid_node,
+            const Chunk& chunk, LoadStats& stats) const;
+
+    /*!
+     * Write the body ids over the chunk's segments (in place).  The
+     * labels being replaced are added to the undo snapshot first.
+     * \return false if a conditional overwrite changed nothing, in
+     * which case the chunk need not be written
+    */
+    bool relabel_chunk(const SparseVolume& volume, const Chunk& chunk,
+            libdvid::Labels3D& labels, LoadStats& stats) const;
+
+    //! post relabeled labels back to DVID
+    void write_chunk(libdvid::DVIDNodeService& dvid_node, const Chunk& chunk,
+            libdvid::Labels3D& labels, LoadStats& stats) const;
+
+    /*!
+     * Fetch the chunk, write the body ids over its segments, and
+     * post it back to DVID (unless nothing changed).
+    */
+    void load_chunk(libdvid::DVIDNodeService& dvid_node, const SparseVolume& volume,
+            const Chunk& chunk, LoadStats& stats) const;
+
+    int get_block_size() const
+    {
+        return block_size;
+    }
+
+  private:
+    void record_undo(const SparseVolume& volume, const Chunk& chunk,
+            const unsigned long long* ldata_raw) const;
+
+    std::string label_name;
+    int block_size;
+    bool compress;
+    OverwriteCondition condition;
+    UndoSnapshot* snapshot;
+};
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "ChunkOrder.h"
+#include "MortonCode.h"
+
+#include <algorithm>
+
+using std::vector;
+
+namespace DVIDLoadSparse {
+
+static const int COORD_BITS = DVIDUtils::MORTON_BITS;
+static const int COORD_BIAS = 1 << (COORD_BITS - 1);
+
+// block coordinates packed without interleaving (cache key)
+static unsigned long long block_key(int bx, int by, int bz)
+{
+    unsigned long long mask = (1ULL << COORD_BITS) - 1;
+    return (((unsigned long long) (bz + COORD_BIAS) & mask) << (2 * COORD_BITS)) |
+        (((unsigned long long) (by + COORD_BIAS) & mask) << COORD_BITS) |
+        ((unsigned long long) (bx + COORD_BIAS) & mask);
+}
+
+unsigned long long morton_code(const Chunk& chunk, int block_size)
+{
+    return DVIDUtils::morton_code(floor_div(chunk.x1, block_size) + COORD_BIAS,
+            floor_div(chunk.y1, block_size) + COORD_BIAS,
+            floor_div(chunk.z1, block_size) + COORD_BIAS);
+}
+
+void morton_order(vector<Chunk>& chunks, int block_size)
+{
+    // (code, plan position) pairs sort stably
+    vector<std::pair<unsigned long long, size_t> > keys(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        keys[i] = std::make_pair(morton_code(chunks[i], block_size), i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    vector<Chunk> ordered;
+    ordered.reserve(chunks.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ordered.push_back(chunks[keys[i].second]);
+    }
+    chunks.swap(ordered);
+}
+
+void BlockCacheModel::touch_chunks(const vector<Chunk>& chunks)
+{
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+        const Chunk& chunk = chunks[i];
+        for (int bz = floor_div(chunk.z1, block_size);
+                bz <= floor_div(chunk.z2, block_size); ++bz) {
+            for (int by = floor_div(chunk.y1, block_size);
+                    by <= floor_div(chunk.y2, block_size); ++by) {
+                for (int bx = floor_div(chunk.x1, block_size);
+                        bx <= floor_div(chunk.x2, block_size); ++bx) {
+                    touch(block_key(bx, by, bz));
+                }
+            }
+        }
+    }
+}
+
+void BlockCacheModel::touch(unsigned long long block)
+{
+    ++touches;
+    std::tr1::unordered_map<unsigned long long,
+        std::list<unsigned long long>::iterator>::iterator iter = block2lru.find(block);
+    if (iter != block2lru.end()) {
+        ++hits;
+        lru.splice(lru.begin(), lru, iter->second);
+        return;
+    }
+
+    lru.push_front(block);
+    block2lru[block] = lru.begin();
+    if (block2lru.size() > capacity) {
+        block2lru.erase(lru.back());
+        lru.pop_back();
+    }
+}
+
+}
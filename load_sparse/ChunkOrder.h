@@ -0,0 +1,76 @@
+/*!
+ * Scheduling order for chunks.  Chunks are visited along a Z-order
+ * (Morton) curve over DVID block coordinates so that consecutive
+ * chunks touch nearby blocks and blocks cached by the server are
+ * reused.  A simple LRU model of a block cache measures how well an
+ * order reuses blocks.
+*/
+
+#ifndef CHUNKORDER_H
+#define CHUNKORDER_H
+
+#include "ChunkLoader.h"
+
+#include <tr1/unordered_map>
+#include <list>
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+/*!
+ * Morton code of the block containing the chunk's first voxel.
+ * Block coordinates use 21 bits each (about +-1M blocks).
+*/
+unsigned long long morton_code(const Chunk& chunk, int block_size);
+
+/*!
+ * Sort chunks by the Morton code of their first block.  Ties keep
+ * plan order, so the planes of one block row stay sorted by z.
+*/
+void morton_order(std::vector<Chunk>& chunks, int block_size);
+
+/*!
+ * LRU model of a server-side block cache.  Each chunk touches every
+ * block it intersects once (the write right after the fetch always
+ * hits, so it is not counted).
+*/
+class BlockCacheModel {
+  public:
+    /*!
+     * \param capacity_ number of blocks the cache holds
+     * \param block_size_ DVID block size
+    */
+    BlockCacheModel(size_t capacity_, int block_size_) : capacity(capacity_),
+        block_size(block_size_), touches(0), hits(0) {}
+
+    //! replay the block accesses of chunks in order
+    void touch_chunks(const std::vector<Chunk>& chunks);
+
+    unsigned long long get_touches() const
+    {
+        return touches;
+    }
+
+    //! fraction of block touches found in the cache
+    double hit_rate() const
+    {
+        return touches ? double(hits) / touches : 0.0;
+    }
+
+  private:
+    void touch(unsigned long long block);
+
+    size_t capacity;
+    int block_size;
+    unsigned long long touches;
+    unsigned long long hits;
+
+    //! most recently used block first
+    std::list<unsigned long long> lru;
+    std::tr1::unordered_map<unsigned long long,
+        std::list<unsigned long long>::iterator> block2lru;
+};
+
+}
+
+#endif
@@ -0,0 +1,233 @@
+#include "ChunkPipeline.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind/bind.hpp>
+#include <tr1/unordered_map>
+#include <stdexcept>
+#include <algorithm>
+
+using std::string;
+using std::vector;
+using std::tr1::unordered_map;
+
+namespace DVIDLoadSparse {
+
+ChunkPipeline::ChunkPipeline(string server, string uuid, const ChunkLoader& loader_,
+        int num_threads_, int max_inflight_, Journal* journal_) : loader(loader_),
+    journal(journal_), num_threads(num_threads_), max_inflight(max_inflight_), volume(0),
+    chunks(0), stats(0), inflight(0), failed(false)
+{
+    // connections are created up front on the main thread
+    for (int i = 0; i < num_threads; ++i) {
+        fetch_nodes.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                    new libdvid::DVIDNodeService(server, uuid)));
+        write_nodes.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                    new libdvid::DVIDNodeService(server, uuid)));
+    }
+}
+
+void ChunkPipeline::compute_dependencies()
+{
+    const vector<Chunk>& chunk_list = *chunks;
+    int block_size = loader.get_block_size();
+    dependents.assign(chunk_list.size(), vector<size_t>());
+    unwritten_dependencies.assign(chunk_list.size(), 0);
+
+    // chunks bucketed by the z block rows they cover
+    unordered_map<int, vector<size_t> > zblock2chunks;
+    vector<size_t> last_dependent(chunk_list.size(), chunk_list.size());
+
+    for (size_t i = 0; i < chunk_list.size(); ++i) {
+        const Chunk& chunk = chunk_list[i];
+        int zblock1 = floor_div(chunk.z1, block_size);
+        int zblock2 = floor_div(chunk.z2, block_size);
+        for (int zblock = zblock1; zblock <= zblock2; ++zblock) {
+            vector<size_t>& bucket = zblock2chunks[zblock];
+            for (unsigned int j = 0; j < bucket.size(); ++j) {
+                size_t prev = bucket[j];
+                if (last_dependent[prev] != i &&
+                        chunks_share_block(chunk, chunk_list[prev], block_size)) {
+                    dependents[prev].push_back(i);
+                    ++unwritten_dependencies[i];
+                    last_dependent[prev] = i;
+                }
+            }
+            bucket.push_back(i);
+        }
+    }
+
+    ready.clear();
+    for (size_t i = 0; i < chunk_list.size(); ++i) {
+        if (unwritten_dependencies[i] == 0) {
+            ready.insert(ready.end(), i);
+        }
+    }
+}
+
+void ChunkPipeline::run(const SparseVolume& volume_, const vector<Chunk>& chunks_,
+        LoadStats& stats_)
+{
+    volume = &volume_;
+    chunks = &chunks_;
+    stats = &stats_;
+    compute_dependencies();
+
+    // queues are closed at the end of the previous run
+    fetch_queue.reopen();
+    relabel_queue.reopen();
+    write_queue.reopen();
+
+    // relabeling is cpu bound and needs no connection
+    int num_relabel = std::max(1, std::min(num_threads,
+                (int) boost::thread::hardware_concurrency()));
+
+    boost::thread_group fetch_threads, relabel_threads, write_threads;
+    for (int i = 0; i < num_threads; ++i) {
+        fetch_threads.create_thread(boost::bind(&ChunkPipeline::fetch_worker,
+                    this, fetch_nodes[i].get()));
+        write_threads.create_thread(boost::bind(&ChunkPipeline::write_worker,
+                    this, write_nodes[i].get()));
+    }
+    for (int i = 0; i < num_relabel; ++i) {
+        relabel_threads.create_thread(boost::bind(&ChunkPipeline::relabel_worker, this));
+    }
+
+    // dispatch ready chunks, earliest in the plan first, as memory allows
+    for (size_t dispatched = 0; dispatched < chunks->size(); ++dispatched) {
+        size_t chunk_id;
+        {
+            boost::mutex::scoped_lock lock(state_mutex);
+            while (!failed && (inflight >= max_inflight || ready.empty())) {
+                state_changed.wait(lock);
+            }
+            if (failed) {
+                break;
+            }
+            chunk_id = *ready.begin();
+            ready.erase(ready.begin());
+            ++inflight;
+        }
+        fetch_queue.push(chunk_id);
+    }
+
+    // drain the stages in order
+    fetch_queue.close();
+    fetch_threads.join_all();
+    relabel_queue.close();
+    relabel_threads.join_all();
+    write_queue.close();
+    write_threads.join_all();
+
+    if (failed) {
+        throw std::runtime_error(error_msg);
+    }
+}
+
+void ChunkPipeline::fetch_worker(libdvid::DVIDNodeService* dvid_node)
+{
+    LoadStats worker_stats;
+    size_t chunk_id;
+    while (fetch_queue.pop(chunk_id)) {
+        if (has_failed()) {
+            continue;
+        }
+        try {
+            ChunkData data;
+            data.chunk_id = chunk_id;
+            data.labels = loader.fetch_chunk(*dvid_node, (*chunks)[chunk_id], worker_stats);
+            relabel_queue.push(data);
+        } catch (std::exception& e) {
+            fail(e.what());
+        }
+    }
+    merge_stats(worker_stats);
+}
+
+void ChunkPipeline::relabel_worker()
+{
+    LoadStats worker_stats;
+    ChunkData data;
+    while (relabel_queue.pop(data)) {
+        if (has_failed()) {
+            continue;
+        }
+        try {
+            if (loader.relabel_chunk(*volume, (*chunks)[data.chunk_id], data.labels,
+                        worker_stats)) {
+                write_queue.push(data);
+                continue;
+            }
+
+            // nothing changed so the chunk is done without a write
+            if (journal) {
+                journal->commit((*chunks)[data.chunk_id].id);
+            }
+            data.labels = libdvid::Labels3D();
+            finish_chunk(data.chunk_id);
+        } catch (std::exception& e) {
+            fail(e.what());
+        }
+    }
+    merge_stats(worker_stats);
+}
+
+void ChunkPipeline::write_worker(libdvid::DVIDNodeService* dvid_node)
+{
+    LoadStats worker_stats;
+    ChunkData data;
+    while (write_queue.pop(data)) {
+        if (has_failed()) {
+            continue;
+        }
+        try {
+            loader.write_chunk(*dvid_node, (*chunks)[data.chunk_id], data.labels,
+                    worker_stats);
+            if (journal) {
+                journal->commit((*chunks)[data.chunk_id].id);
+            }
+            // release the buffer before another chunk can be admitted
+            data.labels = libdvid::Labels3D();
+            finish_chunk(data.chunk_id);
+        } catch (std::exception& e) {
+            fail(e.what());
+        }
+    }
+    merge_stats(worker_stats);
+}
+
+void ChunkPipeline::finish_chunk(size_t chunk_id)
+{
+    boost::mutex::scoped_lock lock(state_mutex);
+    vector<size_t>& waiting = dependents[chunk_id];
+    for (unsigned int i = 0; i < waiting.size(); ++i) {
+        if (--unwritten_dependencies[waiting[i]] == 0) {
+            ready.insert(waiting[i]);
+        }
+    }
+    --inflight;
+    state_changed.notify_all();
+}
+
+void ChunkPipeline::fail(string msg)
+{
+    boost::mutex::scoped_lock lock(state_mutex);
+    if (!failed) {
+        failed = true;
+        error_msg = msg;
+    }
+    state_changed.notify_all();
+}
+
+bool ChunkPipeline::has_failed()
+{
+    boost::mutex::scoped_lock lock(state_mutex);
+    return failed;
+}
+
+void ChunkPipeline::merge_stats(const LoadStats& worker_stats)
+{
+    boost::mutex::scoped_lock lock(stats_mutex);
+    stats->merge(worker_stats);
+}
+
+}
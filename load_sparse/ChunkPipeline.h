@@ -0,0 +1,104 @@
+/*!
+ * Multi-threaded engine that runs the fetch, relabel, and write
+ * stages of the chunk loader concurrently.  At most max_inflight
+ * chunks are held in memory.  A chunk is not fetched until every
+ * earlier chunk sharing a DVID block with it has been written, so
+ * overlapping read-modify-writes happen in plan order.  Chunks whose
+ * dependencies are written are dispatched lowest plan index first,
+ * so a blocked chunk does not hold back independent later ones.
+*/
+
+#ifndef CHUNKPIPELINE_H
+#define CHUNKPIPELINE_H
+
+#include "ChunkLoader.h"
+#include "WorkQueue.h"
+#include "Journal.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <string>
+#include <vector>
+#include <set>
+
+namespace DVIDLoadSparse {
+
+class ChunkPipeline {
+  public:
+    /*!
+     * Create the pipeline and one DVID connection per network worker.
+     * \param server dvid server name
+     * \param uuid dvid node uuid
+     * \param loader performs the chunk stages
+     * \param num_threads number of fetch and number of write workers
+     * \param max_inflight maximum chunks fetched but not yet written
+     * \param journal records written chunks (optional)
+    */
+    ChunkPipeline(std::string server, std::string uuid, const ChunkLoader& loader,
+            int num_threads, int max_inflight, Journal* journal = 0);
+
+    /*!
+     * Load all chunks.  Every chunk is written before run returns,
+     * so it can be called again for the next batch of chunks (the
+     * connections are reused).  Throws std::runtime_error with the
+     * first worker error; chunks already written stay written.
+    */
+    void run(const SparseVolume& volume, const std::vector<Chunk>& chunks,
+            LoadStats& stats);
+
+  private:
+    struct ChunkData {
+        size_t chunk_id;
+        libdvid::Labels3D labels;
+    };
+
+    void compute_dependencies();
+
+    void fetch_worker(libdvid::DVIDNodeService* dvid_node);
+    void relabel_worker();
+    void write_worker(libdvid::DVIDNodeService* dvid_node);
+
+    void finish_chunk(size_t chunk_id);
+    void fail(std::string msg);
+    bool has_failed();
+    void merge_stats(const LoadStats& worker_stats);
+
+    const ChunkLoader& loader;
+    Journal* journal;
+    int num_threads;
+    int max_inflight;
+
+    std::vector<boost::shared_ptr<libdvid::DVIDNodeService> > fetch_nodes;
+    std::vector<boost::shared_ptr<libdvid::DVIDNodeService> > write_nodes;
+
+    // set for the duration of run
+    const SparseVolume* volume;
+    const std::vector<Chunk>* chunks;
+    LoadStats* stats;
+
+    //! later chunks that wait for a chunk to be written
+    std::vector<std::vector<size_t> > dependents;
+
+    DVIDUtils::WorkQueue<size_t> fetch_queue;
+    DVIDUtils::WorkQueue<ChunkData> relabel_queue;
+    DVIDUtils::WorkQueue<ChunkData> write_queue;
+
+    // scheduling state protected by state_mutex
+    boost::mutex state_mutex;
+    boost::condition_variable state_changed;
+    //! earlier chunks not yet written, per chunk
+    std::vector<unsigned int> unwritten_dependencies;
+    //! chunks not yet dispatched whose dependencies are written
+    std::set<size_t> ready;
+    int inflight;
+    bool failed;
+    std::string error_msg;
+
+    boost::mutex stats_mutex;
+};
+
+}
+
+#endif
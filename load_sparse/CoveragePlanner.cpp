@@ -0,0 +1,219 @@
+#include "CoveragePlanner.h"
+
+#include <algorithm>
+
+using std::vector;
+using std::pair;
+
+namespace DVIDLoadSparse {
+
+void CoveragePlanner::split_chunks(const SparseVolume& volume,
+        const vector<Chunk>& chunks, vector<Chunk>& split) const
+{
+    vector<unsigned long long> block_counts;
+    vector<char> coverage;
+    vector<BlockRect> full_rects, partial_rects;
+
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+        const Chunk& chunk = chunks[i];
+        if (!aligned) {
+            Chunk covered = chunk;
+            covered.write_only = (covered_voxels(volume, chunk, 0) == chunk.volume());
+            split.push_back(covered);
+            continue;
+        }
+
+        if (covered_voxels(volume, chunk, &block_counts) == chunk.volume()) {
+            Chunk covered = chunk;
+            covered.write_only = true;
+            split.push_back(covered);
+            continue;
+        }
+        unsigned long long block_volume =
+            (unsigned long long) block_size * block_size * block_size;
+        coverage.resize(block_counts.size());
+        bool has_full = false;
+        for (unsigned int j = 0; j < block_counts.size(); ++j) {
+            if (block_counts[j] == 0) {
+                coverage[j] = EMPTY;
+            } else if (block_counts[j] == block_volume) {
+                coverage[j] = FULL;
+                has_full = true;
+            } else {
+                coverage[j] = PARTIAL;
+            }
+        }
+        if (!has_full) {
+            split.push_back(chunk);
+            continue;
+        }
+        
+        int nbx = chunk.width() / block_size;
+        int nby = chunk.height() / block_size;
+        int nbz = chunk.depth() / block_size;
+        full_rects.clear();
+        partial_rects.clear();
+        block_rects(coverage, nbx, nby, nbz, FULL, full_rects);
+        block_rects(coverage, nbx, nby, nbz, PARTIAL, partial_rects);
+
+        vector<Chunk> pieces;
+        double split_cost = 0;
+        for (unsigned int j = 0; j < full_rects.size(); ++j) {
+            pieces.push_back(make_chunk(volume, chunk, full_rects[j], true));
+            split_cost += chunk_cost(pieces.back());
+        }
+        for (unsigned int j = 0; j < partial_rects.size(); ++j) {
+            pieces.push_back(make_chunk(volume, chunk, partial_rects[j], false));
+            split_cost += chunk_cost(pieces.back());
+        }
+
+        if (split_cost < chunk_cost(chunk)) {
+            split.insert(split.end(), pieces.begin(), pieces.end());
+        } else {
+            split.push_back(chunk);
+        }
+    }
+}
+
+unsigned long long CoveragePlanner::covered_voxels(const SparseVolume& volume,
+        const Chunk& chunk, vector<unsigned long long>* block_counts) const
+{
+    int cbx1 = floor_div(chunk.x1, block_size);
+    int cby1 = floor_div(chunk.y1, block_size);
+    int cbz1 = floor_div(chunk.z1, block_size);
+    int nbx = floor_div(chunk.x2, block_size) - cbx1 + 1;
+    int nby = floor_div(chunk.y2, block_size) - cby1 + 1;
+    int nbz = floor_div(chunk.z2, block_size) - cbz1 + 1;
+    if (block_counts) {
+        block_counts->assign((size_t) nbx * nby * nbz, 0);
+    }
+
+    // merged x intervals of the current row (a row may repeat and
+    // segments may overlap)
+    vector<pair<int, int> > row;
+    unsigned long long total = 0;
+
+    for (size_t plane = chunk.plane_begin; plane != chunk.plane_end; ++plane) {
+        int z = volume.get_plane_z(plane);
+        if (z < chunk.z1 || z > chunk.z2) {
+            continue;
+        }
+        size_t s = volume.row_lower_bound(plane, chunk.y1);
+        while (s != volume.plane_end(plane) && volume.get_stripe(s).y <= chunk.y2) {
+            int y = volume.get_stripe(s).y;
+            row.clear();
+            for (; s != volume.plane_end(plane) && volume.get_stripe(s).y == y; ++s) {
+                const Stripe& stripe = volume.get_stripe(s);
+                for (unsigned int i = 0; i < stripe.num_segments; ++i) {
+                    int x1 = std::max(stripe.segments[i].x1, chunk.x1);
+                    int x2 = std::min(stripe.segments[i].x2, chunk.x2);
+                    if (x1 <= x2) {
+                        row.push_back(std::make_pair(x1, x2));
+                    }
+                }
+            }
+            std::sort(row.begin(), row.end());
+
+            size_t row_offset = (size_t)(floor_div(y, block_size) - cby1) * nbx +
+                (size_t)(floor_div(z, block_size) - cbz1) * nbx * nby;
+            int start = 0, end = -1;
+            for (unsigned int i = 0; i <= row.size(); ++i) {
+                if (i < row.size() && (end >= start) && row[i].first <= end + 1) {
+                    end = std::max(end, row[i].second);
+                    continue;
+                }
+                // flush merged interval [start, end]
+                if (end >= start) {
+                    total += end - start + 1;
+                    if (block_counts) {
+                        for (int bx = floor_div(start, block_size);
+                                bx <= floor_div(end, block_size); ++bx) {
+                            int x1 = std::max(start, bx * block_size);
+                            int x2 = std::min(end, bx * block_size + block_size - 1);
+                            (*block_counts)[row_offset + (bx - cbx1)] += x2 - x1 + 1;
+                        }
+                    }
+                }
+                if (i < row.size()) {
+                    start = row[i].first;
+                    end = row[i].second;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+void CoveragePlanner::block_rects(const vector<char>& coverage, int nbx, int nby,
+        int nbz, char type, vector<BlockRect>& rects) const
+{
+    // runs of the given type along x, merged with identical runs
+    // in the previous y row
+    for (int bz = 0; bz < nbz; ++bz) {
+        size_t open_begin = rects.size();
+        for (int by = 0; by < nby; ++by) {
+            size_t open_end = rects.size();
+            const char* row = &coverage[((size_t) bz * nby + by) * nbx];
+            int bx = 0;
+            while (bx < nbx) {
+                if (row[bx] != type) {
+                    ++bx;
+                    continue;
+                }
+                int bx2 = bx;
+                while (bx2 + 1 < nbx && row[bx2 + 1] == type) {
+                    ++bx2;
+                }
+
+                bool extended = false;
+                for (size_t r = open_begin; r < open_end; ++r) {
+                    if (rects[r].x1 == bx && rects[r].x2 == bx2 && rects[r].y2 == by - 1) {
+                        rects[r].y2 = by;
+                        extended = true;
+                        break;
+                    }
+                }
+                if (!extended) {
+                    BlockRect rect = { bx, bx2, by, by, bz };
+                    rects.push_back(rect);
+                }
+                bx = bx2 + 1;
+            }
+
+            // rectangles that did not reach this row are closed
+            for (size_t r = open_begin; r < rects.size(); ++r) {
+                if (rects[r].y2 != by) {
+                    std::swap(rects[open_begin], rects[r]);
+                    ++open_begin;
+                }
+            }
+        }
+    }
+}
+
+double CoveragePlanner::chunk_cost(const Chunk& chunk) const
+{
+    int transfers = chunk.write_only ? 1 : 2;
+    return transfers * (request_cost +
+            double(chunk.volume()) * sizeof(unsigned long long));
+}
+
+Chunk CoveragePlanner::make_chunk(const SparseVolume& volume, const Chunk& parent,
+        const BlockRect& rect, bool write_only) const
+{
+    Chunk chunk = parent;
+    chunk.x1 = parent.x1 + rect.x1 * block_size;
+    chunk.x2 = parent.x1 + (rect.x2 + 1) * block_size - 1;
+    chunk.y1 = parent.y1 + rect.y1 * block_size;
+    chunk.y2 = parent.y1 + (rect.y2 + 1) * block_size - 1;
+    chunk.z1 = parent.z1 + rect.z * block_size;
+    chunk.z2 = chunk.z1 + block_size - 1;
+    chunk.write_only = write_only;
+
+    // restrict to the planes inside the block layer
+    chunk.plane_begin = std::max(parent.plane_begin, volume.plane_lower_bound(chunk.z1));
+    chunk.plane_end = std::min(parent.plane_end, volume.plane_lower_bound(chunk.z2 + 1));
+    return chunk;
+}
+
+}
@@ -0,0 +1,67 @@
+/*!
+ * Finds the parts of chunks that the body covers completely.  Such
+ * regions are overwritten entirely by the body id, so they are
+ * written without fetching them first.
+*/
+
+#ifndef COVERAGEPLANNER_H
+#define COVERAGEPLANNER_H
+
+#include "ChunkLoader.h"
+
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+class CoveragePlanner {
+  public:
+    /*!
+     * \param block_size DVID block size
+     * \param request_cost overhead of one request in equivalent bytes
+     * \param aligned chunks are block aligned and may be split into
+     * write-only and read-modify-write block runs
+    */
+    CoveragePlanner(int block_size_, double request_cost_, bool aligned_) :
+        block_size(block_size_), request_cost(request_cost_), aligned(aligned_) {}
+
+    /*!
+     * Mark fully covered chunks write-only.  Block-aligned chunks
+     * that are only partly covered are split into rectangles of
+     * fully covered blocks (write-only) and of partly covered
+     * blocks (read-modify-write) when that costs less than one
+     * read-modify-write of the whole chunk; empty blocks are dropped.
+    */
+    void split_chunks(const SparseVolume& volume, const std::vector<Chunk>& chunks,
+            std::vector<Chunk>& split) const;
+
+  private:
+    enum BlockCoverage {
+        EMPTY,
+        PARTIAL,
+        FULL
+    };
+
+    //! block run [x1, x2] in row (y, z) of the chunk's block grid
+    struct BlockRect {
+        int x1, x2, y1, y2, z;
+    };
+
+    unsigned long long covered_voxels(const SparseVolume& volume, const Chunk& chunk,
+            std::vector<unsigned long long>* block_counts) const;
+
+    void block_rects(const std::vector<char>& coverage, int nbx, int nby, int nbz,
+            char type, std::vector<BlockRect>& rects) const;
+
+    double chunk_cost(const Chunk& chunk) const;
+
+    Chunk make_chunk(const SparseVolume& volume, const Chunk& parent,
+            const BlockRect& rect, bool write_only) const;
+
+    int block_size;
+    double request_cost;
+    bool aligned;
+};
+
+}
+
+#endif
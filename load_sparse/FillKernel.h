@@ -0,0 +1,186 @@
+/*!
+ * Fill kernels for runs of 64-bit labels.  Runs are written with the
+ * widest vector stores available (AVX2 or SSE2) after aligning the
+ * destination, with scalar stores for the ends of the run.
+ * Conditional fills compare and blend a vector at a time.
+*/
+
+#ifndef FILLKERNEL_H
+#define FILLKERNEL_H
+
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace DVIDLoadSparse {
+
+inline void fill_labels(unsigned long long* dst, size_t count, unsigned long long value)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+    const size_t width = 4;
+    __m256i packed = _mm256_set1_epi64x((long long) value);
+#else
+    const size_t width = 2;
+    __m128i packed = _mm_set1_epi64x((long long) value);
+#endif
+    const size_t align_mask = width * sizeof(unsigned long long) - 1;
+
+    // short runs (the common case) are not worth the setup
+    if (count < 2 * width) {
+        for (size_t i = 0; i < count; ++i) {
+            dst[i] = value;
+        }
+        return;
+    }
+
+    // scalar head up to vector alignment
+    while (((size_t) dst) & align_mask) {
+        *dst++ = value;
+        --count;
+    }
+
+    size_t vector_end = count & ~(width - 1);
+    for (size_t i = 0; i < vector_end; i += width) {
+#if defined(__AVX2__)
+        _mm256_store_si256((__m256i*) (dst + i), packed);
+#else
+        _mm_store_si128((__m128i*) (dst + i), packed);
+#endif
+    }
+
+    for (size_t i = vector_end; i < count; ++i) {
+        dst[i] = value;
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = value;
+    }
+#endif
+}
+
+// replace one label if it matches and report whether it changed
+inline size_t replace_label(unsigned long long& label, unsigned long long match1,
+        unsigned long long match2, unsigned long long value)
+{
+    if (label == match1 || label == match2) {
+        label = value;
+        return 1;
+    }
+    return 0;
+}
+
+/*!
+ * Set labels equal to match1 or match2 to value (pass the same
+ * label twice for a single match).
+ * \return number of labels changed
+*/
+inline size_t replace_labels(unsigned long long* dst, size_t count,
+        unsigned long long match1, unsigned long long match2, unsigned long long value)
+{
+    // labels already holding value are not counted as changed
+    if (match1 == value) {
+        match1 = match2;
+    }
+    if (match2 == value) {
+        match2 = match1;
+    }
+    if (match1 == value) {
+        return 0;
+    }
+
+    size_t changed = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+    const size_t width = 4;
+    __m256i packed = _mm256_set1_epi64x((long long) value);
+    __m256i packed1 = _mm256_set1_epi64x((long long) match1);
+    __m256i packed2 = _mm256_set1_epi64x((long long) match2);
+#else
+    const size_t width = 2;
+    __m128i packed = _mm_set1_epi64x((long long) value);
+    __m128i packed1 = _mm_set1_epi64x((long long) match1);
+    __m128i packed2 = _mm_set1_epi64x((long long) match2);
+#endif
+    const size_t align_mask = width * sizeof(unsigned long long) - 1;
+
+    if (count < 2 * width) {
+        for (size_t i = 0; i < count; ++i) {
+            changed += replace_label(dst[i], match1, match2, value);
+        }
+        return changed;
+    }
+
+    while (((size_t) dst) & align_mask) {
+        changed += replace_label(*dst++, match1, match2, value);
+        --count;
+    }
+
+    size_t vector_end = count & ~(width - 1);
+    for (size_t i = 0; i < vector_end; i += width) {
+#if defined(__AVX2__)
+        __m256i labels = _mm256_load_si256((__m256i*) (dst + i));
+        __m256i mask = _mm256_or_si256(_mm256_cmpeq_epi64(labels, packed1),
+                _mm256_cmpeq_epi64(labels, packed2));
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(mask));
+        if (bits) {
+            _mm256_store_si256((__m256i*) (dst + i),
+                    _mm256_blendv_epi8(labels, packed, mask));
+            changed += __builtin_popcount(bits);
+        }
+#else
+        // SSE2 has no 64-bit compare: both 32-bit halves must match
+        __m128i labels = _mm_load_si128((__m128i*) (dst + i));
+        __m128i eq1 = _mm_cmpeq_epi32(labels, packed1);
+        __m128i eq2 = _mm_cmpeq_epi32(labels, packed2);
+        eq1 = _mm_and_si128(eq1, _mm_shuffle_epi32(eq1, _MM_SHUFFLE(2, 3, 0, 1)));
+        eq2 = _mm_and_si128(eq2, _mm_shuffle_epi32(eq2, _MM_SHUFFLE(2, 3, 0, 1)));
+        __m128i mask = _mm_or_si128(eq1, eq2);
+        int bits = _mm_movemask_pd(_mm_castsi128_pd(mask));
+        if (bits) {
+            _mm_store_si128((__m128i*) (dst + i), _mm_or_si128(
+                        _mm_and_si128(mask, packed), _mm_andnot_si128(mask, labels)));
+            changed += __builtin_popcount(bits);
+        }
+#endif
+    }
+
+    for (size_t i = vector_end; i < count; ++i) {
+        changed += replace_label(dst[i], match1, match2, value);
+    }
+#else
+    for (size_t i = 0; i < count; ++i) {
+        changed += replace_label(dst[i], match1, match2, value);
+    }
+#endif
+    return changed;
+}
+
+/*!
+ * Set labels to value where the original labels (orig, the same
+ * span before any body was written) are match1 or match2.  Used when
+ * several bodies share a buffer, so that the condition does not see
+ * labels written by other bodies.
+ * \return number of labels changed
+*/
+inline size_t replace_labels_where(unsigned long long* dst, const unsigned long long* orig,
+        size_t count, unsigned long long match1, unsigned long long match2,
+        unsigned long long value)
+{
+    size_t changed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if ((orig[i] == match1 || orig[i] == match2) && dst[i] != value) {
+            dst[i] = value;
+            ++changed;
+        }
+    }
+    return changed;
+}
+
+}
+
+#endif
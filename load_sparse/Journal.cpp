@@ -0,0 +1,196 @@
+#include "Journal.h"
+#include "BlockRoi.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::ifstream;
+
+namespace DVIDLoadSparse {
+
+static const char JOURNAL_MAGIC[8] = { 'D', 'L', 'S', 'J', 'R', 'N', 'L', '1' };
+
+// FNV-1a over raw bytes
+static void hash_bytes(unsigned long long& hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+unsigned long long plan_fingerprint(const SparseVolume& volume,
+        const vector<Chunk>& chunks, string label_name, int block_size,
+        bool compress, const OverwriteCondition& condition, const BlockRoi* roi)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    hash_bytes(hash, label_name.data(), label_name.size());
+    hash_bytes(hash, &block_size, sizeof(block_size));
+    char flags[2] = { compress, condition.conditional };
+    hash_bytes(hash, flags, sizeof(flags));
+    if (condition.conditional) {
+        hash_bytes(hash, &condition.label1, sizeof(condition.label1));
+        hash_bytes(hash, &condition.label2, sizeof(condition.label2));
+    }
+    if (roi) {
+        vector<int> spans;
+        roi->get_spans(spans);
+        unsigned long long num_spans = spans.size();
+        hash_bytes(hash, &num_spans, sizeof(num_spans));
+        if (!spans.empty()) {
+            hash_bytes(hash, &spans[0], spans.size() * sizeof(int));
+        }
+    }
+
+    for (unsigned int i = 0; i < volume.num_bodies(); ++i) {
+        unsigned long long body_id = volume.get_body_id(i);
+        hash_bytes(hash, &body_id, sizeof(body_id));
+    }
+    // segment data as indexed (after canonicalizing and clipping)
+    unsigned long long num_stripes = volume.num_stripes();
+    hash_bytes(hash, &num_stripes, sizeof(num_stripes));
+    for (size_t s = 0; s < num_stripes; ++s) {
+        const Stripe& stripe = volume.get_stripe(s);
+        int row[4] = { stripe.z, stripe.y, (int) stripe.body, (int) stripe.num_segments };
+        hash_bytes(hash, row, sizeof(row));
+        hash_bytes(hash, stripe.segments, stripe.num_segments * sizeof(Segment));
+    }
+
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+        const Chunk& chunk = chunks[i];
+        int box[7] = { chunk.x1, chunk.y1, chunk.z1, chunk.x2, chunk.y2, chunk.z2,
+            chunk.write_only };
+        hash_bytes(hash, box, sizeof(box));
+    }
+    return hash;
+}
+
+Journal::~Journal()
+{
+    if (fd >= 0) {
+        try {
+            flush();
+        } catch (std::exception&) {
+            // ids not synced are reloaded on resume
+        }
+        ::close(fd);
+    }
+}
+
+bool Journal::open(string filename, unsigned long long fingerprint, bool resume,
+        string& error)
+{
+    bool append = false;
+    if (resume) {
+        ifstream fin(filename.c_str(), std::ios::binary);
+        if (fin) {
+            char magic[8];
+            unsigned long long old_fingerprint = 0;
+            fin.read(magic, sizeof(magic));
+            fin.read((char*) &old_fingerprint, sizeof(old_fingerprint));
+            if (!fin || memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0) {
+                error = "not a load journal";
+                return false;
+            }
+            if (old_fingerprint != fingerprint) {
+                error = "journal was written for a different load plan";
+                return false;
+            }
+
+            // a torn last record is ignored
+            unsigned long long chunk_id;
+            while (fin.read((char*) &chunk_id, sizeof(chunk_id))) {
+                if (chunk_id >= committed.size()) {
+                    committed.resize(chunk_id + 1, 0);
+                }
+                committed[chunk_id] = 1;
+            }
+            append = true;
+        }
+    }
+
+    int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    fd = ::open(filename.c_str(), flags, 0644);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+
+    if (append) {
+        // drop a torn record so new ids stay aligned
+        off_t size = lseek(fd, 0, SEEK_END);
+        off_t header = sizeof(JOURNAL_MAGIC) + sizeof(fingerprint);
+        off_t aligned = header + ((size - header) / 8) * 8;
+        if (aligned != size && ftruncate(fd, aligned) != 0) {
+            error = strerror(errno);
+            return false;
+        }
+    } else {
+        if (write(fd, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != (ssize_t) sizeof(JOURNAL_MAGIC) ||
+                write(fd, &fingerprint, sizeof(fingerprint)) != (ssize_t) sizeof(fingerprint) ||
+                fdatasync(fd) != 0) {
+            error = strerror(errno);
+            return false;
+        }
+    }
+    last_flush = time(0);
+    return true;
+}
+
+size_t Journal::num_committed() const
+{
+    size_t num = 0;
+    for (unsigned int i = 0; i < committed.size(); ++i) {
+        num += committed[i];
+    }
+    return num;
+}
+
+void Journal::commit(size_t chunk_id)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    pending.push_back(chunk_id);
+    if (pending.size() >= batch_size || (time(0) - last_flush) >= flush_seconds) {
+        flush_locked();
+    }
+}
+
+void Journal::flush()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    flush_locked();
+}
+
+void Journal::flush_locked()
+{
+    last_flush = time(0);
+    if (pending.empty()) {
+        return;
+    }
+    size_t size = pending.size() * sizeof(unsigned long long);
+    const char* data = (const char*) &pending[0];
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(string("journal write failed: ") + strerror(errno));
+        }
+        data += written;
+        size -= written;
+    }
+    if (fdatasync(fd) != 0) {
+        throw std::runtime_error(string("journal sync failed: ") + strerror(errno));
+    }
+    pending.clear();
+}
+
+}
@@ -0,0 +1,88 @@
+/*!
+ * Append-only journal of chunks committed to DVID, used to resume
+ * an interrupted load.  The file starts with a magic string and a
+ * fingerprint of the chunk plan, followed by one 64-bit chunk id
+ * per committed chunk.  Ids are buffered and written with one
+ * fdatasync per batch; a chunk written to DVID but not yet synced
+ * is simply loaded again on resume, which gives the same labels.
+*/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "ChunkLoader.h"
+
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+#include <ctime>
+
+namespace DVIDLoadSparse {
+
+class BlockRoi;
+
+/*!
+ * Hash of everything that determines chunk ids and the labels they
+ * write: the chunks, the label volume, the bodies with their
+ * segments, and the options that change what is written.
+ * \param roi region the writes are clipped to (optional)
+*/
+unsigned long long plan_fingerprint(const SparseVolume& volume,
+        const std::vector<Chunk>& chunks, std::string label_name, int block_size,
+        bool compress, const OverwriteCondition& condition, const BlockRoi* roi);
+
+class Journal {
+  public:
+    /*!
+     * \param batch_size_ ids buffered before a sync
+     * \param flush_seconds_ maximum seconds between syncs
+    */
+    Journal(size_t batch_size_ = 256, int flush_seconds_ = 1) : fd(-1),
+        batch_size(batch_size_), flush_seconds(flush_seconds_), last_flush(0) {}
+    ~Journal();
+
+    /*!
+     * Open the journal.  When resuming, committed ids are read from an
+     * existing journal whose fingerprint must match; otherwise the
+     * journal is started over.
+     * \param filename journal file
+     * \param fingerprint plan fingerprint
+     * \param resume keep ids from an existing journal
+     * \param error reason for failure
+     * \return false if the journal cannot be used
+    */
+    bool open(std::string filename, unsigned long long fingerprint, bool resume,
+            std::string& error);
+
+    bool is_committed(size_t chunk_id) const
+    {
+        return (chunk_id < committed.size()) && committed[chunk_id];
+    }
+
+    size_t num_committed() const;
+
+    /*!
+     * Record a committed chunk (thread-safe).  Throws std::runtime_error
+     * if the journal cannot be written.
+    */
+    void commit(size_t chunk_id);
+
+    //! write and sync buffered ids
+    void flush();
+
+  private:
+    void flush_locked();
+
+    int fd;
+    size_t batch_size;
+    int flush_seconds;
+    time_t last_flush;
+
+    std::vector<char> committed;
+    std::vector<unsigned long long> pending;
+    boost::mutex mutex;
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*!
+ * Request and transfer counters reported at the end of a load.
+*/
+
+#ifndef LOADSTATS_H
+#define LOADSTATS_H
+
+#include "WireBytes.h"
+
+#include <ostream>
+
+namespace DVIDLoadSparse {
+
+struct LoadStats {
+    LoadStats() : requests(0), bytes(0), block_writes(0),
+        baseline_requests(0), baseline_bytes(0), baseline_block_writes(0),
+        write_only_chunks(0), fetch_bytes_avoided(0), voxels_changed(0),
+        voxels_skipped(0), unchanged_chunks(0) {}
+
+    //! http requests issued to DVID
+    unsigned long long requests;
+    //! label bytes fetched and posted
+    unsigned long long bytes;
+    //! bytes actually sent or received (estimated when compressed)
+    DVIDUtils::WireBytes wire;
+    //! DVID blocks touched by writes (counting rewrites)
+    unsigned long long block_writes;
+
+    //! what a one plane per read-modify-write load would have needed
+    unsigned long long baseline_requests;
+    unsigned long long baseline_bytes;
+    unsigned long long baseline_block_writes;
+
+    //! chunks written without being fetched first
+    unsigned long long write_only_chunks;
+    unsigned long long fetch_bytes_avoided;
+
+    //! body voxels relabeled and left alone by a conditional overwrite
+    unsigned long long voxels_changed;
+    unsigned long long voxels_skipped;
+    //! chunks not written since no voxel changed
+    unsigned long long unchanged_chunks;
+
+    //! accumulate counters from another stage or thread
+    void merge(const LoadStats& other)
+    {
+        requests += other.requests;
+        bytes += other.bytes;
+        wire.merge(other.wire);
+        block_writes += other.block_writes;
+        baseline_requests += other.baseline_requests;
+        baseline_bytes += other.baseline_bytes;
+        baseline_block_writes += other.baseline_block_writes;
+        write_only_chunks += other.write_only_chunks;
+        fetch_bytes_avoided += other.fetch_bytes_avoided;
+        voxels_changed += other.voxels_changed;
+        voxels_skipped += other.voxels_skipped;
+        unchanged_chunks += other.unchanged_chunks;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "Requests: " << requests << " (per-plane: " << baseline_requests
+            << ", saved: " << (long long)(baseline_requests - requests) << ")" << std::endl;
+        os << "Label bytes transferred: " << bytes << " (per-plane: " << baseline_bytes
+            << ", saved: " << (long long)(baseline_bytes - bytes) << ")" << std::endl;
+        os << "Bytes on wire: ";
+        wire.print(os);
+        if (wire.estimated() && wire.total()) {
+            os << ", compression ratio: " << double(bytes) / wire.total();
+        }
+        os << std::endl;
+        os << "Block writes: " << block_writes << " (per-plane: " << baseline_block_writes
+            << ")" << std::endl;
+        if (write_only_chunks) {
+            os << "Write-only chunks: " << write_only_chunks << " (fetch bytes avoided: "
+                << fetch_bytes_avoided << ")" << std::endl;
+        }
+        if (voxels_changed || voxels_skipped) {
+            os << "Voxels changed: " << voxels_changed << " (skipped: " << voxels_skipped
+                << ", chunks unchanged: " << unchanged_chunks << ")" << std::endl;
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "RleWriter.h"
+
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+using std::vector;
+using std::string;
+
+namespace DVIDLoadSparse {
+
+static const unsigned int RLE_HEADER_SIZE = 12;
+static const unsigned int RLE_SPAN_SIZE = 16;
+// the header stores the span count as uint32
+static const unsigned long long RLE_MAX_SPANS = UINT_MAX;
+
+// write header for the given number of spans
+static void write_header(char* data, unsigned int num_spans)
+{
+    unsigned int num_voxels = 0;
+    data[0] = 0; // labels only
+    data[1] = 3; // dimensions
+    data[2] = 0; // run along x
+    data[3] = 0;
+    memcpy(data + 4, &num_voxels, sizeof(num_voxels));
+    memcpy(data + 8, &num_spans, sizeof(num_spans));
+}
+
+void RleWriter::write_bodies(libdvid::DVIDNodeService& dvid_node,
+        const SparseVolume& volume, LoadStats& stats) const
+{
+    // spans per body so payloads can be sized exactly
+    vector<unsigned long long> body_spans(volume.num_bodies(), 0);
+    for (size_t s = 0; s < volume.num_stripes(); ++s) {
+        const Stripe& stripe = volume.get_stripe(s);
+        body_spans[stripe.body] += stripe.num_segments;
+    }
+
+    // body -> stripes in (z, y) order
+    vector<size_t> body_offsets(volume.num_bodies() + 1, 0);
+    for (size_t s = 0; s < volume.num_stripes(); ++s) {
+        ++body_offsets[volume.get_stripe(s).body + 1];
+    }
+    for (unsigned int b = 0; b < volume.num_bodies(); ++b) {
+        body_offsets[b+1] += body_offsets[b];
+    }
+    vector<size_t> body_stripes(volume.num_stripes());
+    vector<size_t> fill(body_offsets.begin(), body_offsets.end() - 1);
+    for (size_t s = 0; s < volume.num_stripes(); ++s) {
+        body_stripes[fill[volume.get_stripe(s).body]++] = s;
+    }
+
+    unsigned long long request_spans = max_spans ?
+        std::min(max_spans, RLE_MAX_SPANS) : RLE_MAX_SPANS;
+
+    for (unsigned int b = 0; b < volume.num_bodies(); ++b) {
+        unsigned long long body_id = volume.get_body_id(b);
+        unsigned long long remaining = body_spans[b];
+        
+        libdvid::BinaryDataPtr payload;
+        char* pos = 0;
+        unsigned long long payload_spans = 0;
+
+        for (size_t i = body_offsets[b]; i < body_offsets[b+1]; ++i) {
+            const Stripe& stripe = volume.get_stripe(body_stripes[i]);
+            for (unsigned int j = 0; j < stripe.num_segments; ++j) {
+                if (!payload) {
+                    payload_spans = std::min(remaining, request_spans);
+                    remaining -= payload_spans;
+                    payload = libdvid::BinaryData::create_binary_data(0, 0);
+                    payload->get_data().resize(RLE_HEADER_SIZE +
+                            payload_spans * RLE_SPAN_SIZE);
+                    pos = &(payload->get_data()[0]);
+                    write_header(pos, payload_spans);
+                    pos += RLE_HEADER_SIZE;
+                }
+
+                int span[4] = { stripe.segments[j].x1, stripe.y, stripe.z,
+                    stripe.segments[j].x2 - stripe.segments[j].x1 + 1 };
+                memcpy(pos, span, sizeof(span));
+                pos += RLE_SPAN_SIZE;
+
+                if (--payload_spans == 0) {
+                    post_payload(dvid_node, body_id, payload, stats);
+                    payload.reset();
+                }
+            }
+        }
+    }
+}
+
+void RleWriter::post_payload(libdvid::DVIDNodeService& dvid_node,
+        unsigned long long body_id, libdvid::BinaryDataPtr payload,
+        LoadStats& stats) const
+{
+    std::ostringstream sstr;
+    sstr << "/" << label_name << "/" << endpoint << "/" << body_id;
+    dvid_node.custom_request(sstr.str(), payload, libdvid::POST, compress);
+
+    unsigned long long size = payload->length();
+    stats.requests += 1;
+    stats.bytes += size;
+    stats.wire.add((const char*) payload->get_raw(), size, compress);
+}
+
+}
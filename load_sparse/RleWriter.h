@@ -0,0 +1,61 @@
+/*!
+ * Writes bodies as DVID sparse volumes instead of label subvolumes.
+ * The spans are encoded directly in DVID's RLE format:
+ *
+ *   byte   payload descriptor (0: label only)
+ *   uint8  number of dimensions (3)
+ *   uint8  dimension of run (0 = x)
+ *   byte   reserved
+ *   uint32 number of voxels (0, unused)
+ *   uint32 number of spans
+ *   repeated: int32 x, int32 y, int32 z, int32 run length
+ *
+ * so the request size scales with the number of spans rather than
+ * with the bounding box of the body.
+*/
+
+#ifndef RLEWRITER_H
+#define RLEWRITER_H
+
+#include "SparseVolume.h"
+#include "LoadStats.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <string>
+
+namespace DVIDLoadSparse {
+
+class RleWriter {
+  public:
+    /*!
+     * \param label_name_ label instance receiving the sparse volumes
+     * \param endpoint_ path under the instance; the body id is appended
+     * \param max_spans_ spans per request (0 sends each body in as few
+     * requests as the 32-bit span count allows)
+     * \param compress_ lz4 compress the payload
+    */
+    RleWriter(std::string label_name_, std::string endpoint_,
+            unsigned long long max_spans_, bool compress_) :
+        label_name(label_name_), endpoint(endpoint_),
+        max_spans(max_spans_), compress(compress_) {}
+
+    /*!
+     * Post every body of the volume in body order, so later bodies
+     * overwrite earlier ones as in chunked loads.
+    */
+    void write_bodies(libdvid::DVIDNodeService& dvid_node,
+            const SparseVolume& volume, LoadStats& stats) const;
+
+  private:
+    void post_payload(libdvid::DVIDNodeService& dvid_node, unsigned long long body_id,
+            libdvid::BinaryDataPtr payload, LoadStats& stats) const;
+
+    std::string label_name;
+    std::string endpoint;
+    unsigned long long max_spans;
+    bool compress;
+};
+
+}
+
+#endif
@@ -0,0 +1,370 @@
+#include "SparseVolume.h"
+#include "BlockRoi.h"
+
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+namespace DVIDLoadSparse {
+
+// order stripes by plane then row
+static bool stripe_less(const Stripe& s1, const Stripe& s2)
+{
+    return (s1.z < s2.z) || ((s1.z == s2.z) && (s1.y < s2.y));
+}
+
+static bool segment_less(const Segment& s1, const Segment& s2)
+{
+    return (s1.x1 < s2.x1) || ((s1.x1 == s2.x1) && (s1.x2 < s2.x2));
+}
+
+// segments are valid, sorted, and neither overlap nor touch
+static bool is_canonical(const Stripe& stripe)
+{
+    if (stripe.num_segments == 0) {
+        return false;
+    }
+    for (unsigned int i = 0; i < stripe.num_segments; ++i) {
+        if (stripe.segments[i].x1 > stripe.segments[i].x2) {
+            return false;
+        }
+        if (i > 0 && stripe.segments[i].x1 <= stripe.segments[i-1].x2 + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// read a file that cannot be mapped (pipe or terminal) to its end
+static bool read_all(int fd, vector<int>& buffer)
+{
+    const size_t piece = 1 << 20;
+    size_t bytes = 0;
+    while (true) {
+        buffer.resize((bytes + piece) / sizeof(int) + 1);
+        ssize_t count = read(fd, (char*) &buffer[0] + bytes,
+                buffer.size() * sizeof(int) - bytes);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (count == 0) {
+            break;
+        }
+        bytes += count;
+    }
+    buffer.resize(bytes / sizeof(int));
+    return true;
+}
+
+SparseVolume::~SparseVolume()
+{
+    close();
+}
+
+void SparseVolume::close()
+{
+    for (unsigned int i = 0; i < mappings.size(); ++i) {
+        munmap((void*) mappings[i].first, mappings[i].second);
+    }
+    mappings.clear();
+}
+
+bool SparseVolume::add_body(string filename, unsigned long long body_id)
+{
+    bool is_stdin = (filename == "-");
+    int fd = is_stdin ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        if (!is_stdin) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    // streams are read in full since they cannot be mapped
+    if (!S_ISREG(file_stat.st_mode)) {
+        vector<int> buffer;
+        bool read_ok = read_all(fd, buffer);
+        if (!is_stdin) {
+            ::close(fd);
+        }
+        return read_ok && add_body_buffer(buffer, body_id);
+    }
+    if (file_stat.st_size < (off_t) sizeof(int)) {
+        if (!is_stdin) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    size_t mapped_size = file_stat.st_size;
+    void* data = mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (!is_stdin) {
+        ::close(fd);
+    }
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    // the stripes are read in one front-to-back pass
+    madvise(data, mapped_size, MADV_SEQUENTIAL);
+    size_t old_size = stripes.size();
+    if (!parse((const char*) data, mapped_size, body_ids.size())) {
+        stripes.resize(old_size);
+        munmap(data, mapped_size);
+        return false;
+    }
+    madvise(data, mapped_size, MADV_RANDOM);
+
+    mappings.push_back(std::make_pair((const char*) data, mapped_size));
+    body_ids.push_back(body_id);
+    return true;
+}
+
+bool SparseVolume::add_body_buffer(vector<int>& buffer, unsigned long long body_id)
+{
+    if (buffer.empty()) {
+        return false;
+    }
+    buffers.push_back(vector<int>());
+    buffers.back().swap(buffer);
+
+    size_t old_size = stripes.size();
+    if (!parse((const char*) &buffers.back()[0],
+                buffers.back().size() * sizeof(int), body_ids.size())) {
+        stripes.resize(old_size);
+        buffers.pop_back();
+        return false;
+    }
+    body_ids.push_back(body_id);
+    return true;
+}
+
+bool SparseVolume::parse(const char* data, size_t size, unsigned int body)
+{
+    const int* pos = (const int*) data;
+    const int* end = pos + (size / sizeof(int));
+
+    int num_stripes = *pos++;
+    if (num_stripes < 0) {
+        return false;
+    }
+    stripes.reserve(stripes.size() + num_stripes);
+
+    for (int i = 0; i < num_stripes; ++i) {
+        if ((end - pos) < 3) {
+            return false;
+        }
+        Stripe stripe;
+        stripe.z = pos[0];
+        stripe.y = pos[1];
+        int num_segments = pos[2];
+        pos += 3;
+        if (num_segments < 0 || (end - pos) / 2 < num_segments) {
+            return false;
+        }
+        stripe.num_segments = num_segments;
+        stripe.body = body;
+        stripe.segments = (const Segment*) pos;
+        pos += 2 * num_segments;
+        stripes.push_back(stripe);
+    }
+    return true;
+}
+
+void SparseVolume::build_index(const BlockRoi* roi)
+{
+    // exporters usually write z-sorted files; keep insertion order
+    // for repeated rows so that overlaps resolve deterministically
+    bool sorted = true;
+    for (size_t i = 1; i < stripes.size() && sorted; ++i) {
+        sorted = !stripe_less(stripes[i], stripes[i-1]);
+    }
+    if (!sorted) {
+        std::stable_sort(stripes.begin(), stripes.end(), stripe_less);
+    }
+    canonicalize(roi);
+
+    // per-plane offsets into the stripe table
+    plane_z.clear();
+    plane_offsets.clear();
+    for (size_t i = 0; i < stripes.size(); ++i) {
+        if (plane_z.empty() || stripes[i].z != plane_z.back()) {
+            plane_z.push_back(stripes[i].z);
+            plane_offsets.push_back(i);
+        }
+    }
+    plane_offsets.push_back(stripes.size());
+}
+
+// voxels covered by sorted, disjoint segments
+static unsigned long long row_voxels(const vector<Segment>& row)
+{
+    unsigned long long voxels = 0;
+    for (unsigned int i = 0; i < row.size(); ++i) {
+        voxels += row[i].x2 - row[i].x1 + 1;
+    }
+    return voxels;
+}
+
+void SparseVolume::canonicalize(const BlockRoi* roi)
+{
+    vector<Segment> row, clipped;
+    
+    // stripes moved to owned storage (stripe position, owned offset)
+    vector<std::pair<size_t, size_t> > owned_rows;
+    owned_segments.clear();
+
+    size_t out = 0;
+    size_t begin = 0;
+    while (begin < stripes.size()) {
+        // a body's stripes for a row are adjacent after the stable sort
+        size_t end = begin + 1;
+        while (end < stripes.size() && stripes[end].z == stripes[begin].z &&
+                stripes[end].y == stripes[begin].y &&
+                stripes[end].body == stripes[begin].body) {
+            ++end;
+        }
+        if (end == begin + 1 && !roi && is_canonical(stripes[begin])) {
+            stripes[out++] = stripes[begin];
+            begin = end;
+            continue;
+        }
+
+        row.clear();
+        unsigned long long num_segments = 0;
+        for (size_t i = begin; i < end; ++i) {
+            num_segments += stripes[i].num_segments;
+            for (unsigned int j = 0; j < stripes[i].num_segments; ++j) {
+                if (stripes[i].segments[j].x1 <= stripes[i].segments[j].x2) {
+                    row.push_back(stripes[i].segments[j]);
+                }
+            }
+        }
+        std::sort(row.begin(), row.end(), segment_less);
+        size_t merged = 0;
+        for (size_t i = 0; i < row.size(); ++i) {
+            if (merged > 0 && row[i].x1 <= row[merged-1].x2 + 1) {
+                row[merged-1].x2 = std::max(row[merged-1].x2, row[i].x2);
+            } else {
+                row[merged++] = row[i];
+            }
+        }
+        row.resize(merged);
+        removed_segments += num_segments - merged;
+
+        if (roi) {
+            roi->clip_row(stripes[begin].z, stripes[begin].y, row, clipped);
+            clipped_voxels += row_voxels(row) - row_voxels(clipped);
+            row.swap(clipped);
+        }
+
+        if (!row.empty()) {
+            Stripe stripe = stripes[begin];
+            stripe.num_segments = row.size();
+            if (row.size() <= stripes[begin].num_segments) {
+                std::copy(row.begin(), row.end(), (Segment*) stripe.segments);
+            } else {
+                owned_rows.push_back(std::make_pair(out, owned_segments.size()));
+                owned_segments.insert(owned_segments.end(), row.begin(), row.end());
+            }
+            stripes[out++] = stripe;
+        }
+        begin = end;
+    }
+    stripes.resize(out);
+
+    // owned storage is complete so pointers into it are stable
+    for (unsigned int i = 0; i < owned_rows.size(); ++i) {
+        stripes[owned_rows[i].first].segments = &owned_segments[owned_rows[i].second];
+    }
+}
+
+unsigned long long SparseVolume::overlap_voxels() const
+{
+    unsigned long long overlap = 0;
+    size_t row_begin = 0;
+    while (row_begin < stripes.size()) {
+        size_t row_end = row_begin + 1;
+        while (row_end < stripes.size() && stripes[row_end].z == stripes[row_begin].z &&
+                stripes[row_end].y == stripes[row_begin].y) {
+            ++row_end;
+        }
+
+        // rows are short, so compare stripes of different bodies pairwise
+        for (size_t i = row_begin; i < row_end; ++i) {
+            for (size_t j = i + 1; j < row_end; ++j) {
+                if (stripes[i].body == stripes[j].body) {
+                    continue;
+                }
+                for (unsigned int si = 0; si < stripes[i].num_segments; ++si) {
+                    for (unsigned int sj = 0; sj < stripes[j].num_segments; ++sj) {
+                        int x1 = std::max(stripes[i].segments[si].x1, stripes[j].segments[sj].x1);
+                        int x2 = std::min(stripes[i].segments[si].x2, stripes[j].segments[sj].x2);
+                        if (x1 <= x2) {
+                            overlap += x2 - x1 + 1;
+                        }
+                    }
+                }
+            }
+        }
+        row_begin = row_end;
+    }
+    return overlap;
+}
+
+size_t SparseVolume::plane_lower_bound(int z) const
+{
+    return std::lower_bound(plane_z.begin(), plane_z.end(), z) - plane_z.begin();
+}
+
+size_t SparseVolume::row_lower_bound(size_t plane, int y) const
+{
+    Stripe key;
+    key.z = plane_z[plane];
+    key.y = y;
+    return std::lower_bound(stripes.begin() + plane_begin(plane),
+            stripes.begin() + plane_end(plane), key, stripe_less) - stripes.begin();
+}
+
+void SparseVolume::plane_bounds(size_t plane, int& minx, int& miny,
+        int& maxx, int& maxy) const
+{
+    maxy = 0;
+    miny = INT_MAX;
+    maxx = 0;
+    minx = INT_MAX;
+    for (size_t i = plane_begin(plane); i != plane_end(plane); ++i) {
+        const Stripe& stripe = stripes[i];
+        if (stripe.y < miny) {
+            miny = stripe.y;
+        }
+        if (stripe.y > maxy) {
+            maxy = stripe.y;
+        }
+
+        for (unsigned int j = 0; j < stripe.num_segments; ++j) {
+            if (stripe.segments[j].x1 < minx) {
+                minx = stripe.segments[j].x1;
+            }
+            if (stripe.segments[j].x2 > maxx) {
+                maxx = stripe.segments[j].x2;
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,187 @@
+/*!
+ * Sparse volume representation used by dvid_load_sparse.  The
+ * sparse file is a list of stripes (z, y) each containing
+ * inclusive x segments:
+ *
+ *   int32 num_stripes
+ *   repeated: int32 z, int32 y, int32 num_segments,
+ *             num_segments x (int32 x1, int32 x2)
+ *
+ * Files are memory mapped and segments are read in place.  Only
+ * a compact stripe table sorted by (z, y) and a per-plane offset
+ * table into it are allocated.  Pipes and standard input cannot be
+ * mapped, so they are read into a buffer.  When streaming, stripes
+ * can also be handed over in buffers with the same layout.  Several bodies can be indexed
+ * together; stripes of the same row keep the order in which their
+ * bodies were added, so later bodies overwrite earlier ones.
+ *
+ * Indexing canonicalizes each row of a body: repeated rows are
+ * combined and segments are sorted, merged, and deduplicated.  Rows
+ * can also be clipped to a region of interest at that point.
+ * Mappings are private and writable so rewritten rows are stored
+ * in place (copy-on-write) when they fit.
+*/
+
+#ifndef SPARSEVOLUME_H
+#define SPARSEVOLUME_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstddef>
+
+namespace DVIDLoadSparse {
+
+class BlockRoi;
+
+//! inclusive x range, laid out as in the sparse file
+struct Segment {
+    int x1, x2;
+};
+
+//! segments of one row (z, y); segments point into the mapped file
+struct Stripe {
+    int z, y;
+    unsigned int num_segments;
+    //! index of the body the stripe belongs to
+    unsigned int body;
+    const Segment* segments;
+};
+
+class SparseVolume {
+  public:
+    SparseVolume() : removed_segments(0), clipped_voxels(0) {}
+    ~SparseVolume();
+
+    /*!
+     * Map a sparse file and add its stripes for the given body.
+     * build_index must be called after all bodies are added.
+     * \param filename name of sparse file ("-" for standard input)
+     * \param body_id label written for the body
+     * \return false if the file cannot be opened or is truncated
+    */
+    bool add_body(std::string filename, unsigned long long body_id);
+
+    /*!
+     * Add stripes for the given body from a buffer in sparse file
+     * layout.  The volume takes the buffer's contents (buffer is
+     * left empty).
+     * \param buffer stripe count followed by stripes
+     * \param body_id label written for the body
+     * \return false if the buffer is truncated
+    */
+    bool add_body_buffer(std::vector<int>& buffer, unsigned long long body_id);
+
+    /*!
+     * Sort and canonicalize the stripes and build the plane table.
+     * \param roi only keep the parts of segments inside it (optional)
+    */
+    void build_index(const BlockRoi* roi = 0);
+
+    //! segments removed by canonicalization (duplicates and overlaps)
+    unsigned long long get_removed_segments() const
+    {
+        return removed_segments;
+    }
+
+    //! voxels dropped for lying outside the region of interest
+    unsigned long long get_clipped_voxels() const
+    {
+        return clipped_voxels;
+    }
+
+    size_t num_bodies() const
+    {
+        return body_ids.size();
+    }
+
+    unsigned long long get_body_id(unsigned int body) const
+    {
+        return body_ids[body];
+    }
+
+    /*!
+     * Voxels claimed by more than one body (counted once per pair of
+     * overlapping segments).
+    */
+    unsigned long long overlap_voxels() const;
+
+    size_t num_planes() const
+    {
+        return plane_z.size();
+    }
+    
+    size_t num_stripes() const
+    {
+        return stripes.size();
+    }
+
+    //! z value of the given plane (planes are sorted by z)
+    int get_plane_z(size_t plane) const
+    {
+        return plane_z[plane];
+    }
+
+    //! stripes of a plane are [plane_begin(plane), plane_end(plane))
+    size_t plane_begin(size_t plane) const
+    {
+        return plane_offsets[plane];
+    }
+    
+    size_t plane_end(size_t plane) const
+    {
+        return plane_offsets[plane+1];
+    }
+
+    /*!
+     * First plane with z value >= z (num_planes if none).
+    */
+    size_t plane_lower_bound(int z) const;
+
+    /*!
+     * First stripe of a plane with row >= y (plane_end if none).
+    */
+    size_t row_lower_bound(size_t plane, int y) const;
+
+    const Stripe& get_stripe(size_t stripe_id) const
+    {
+        return stripes[stripe_id];
+    }
+
+    /*!
+     * Bounding box of all segments in a plane (inclusive).
+    */
+    void plane_bounds(size_t plane, int& minx, int& miny,
+            int& maxx, int& maxy) const;
+
+  private:
+    // not copyable since the mapping is owned
+    SparseVolume(const SparseVolume&);
+    SparseVolume& operator=(const SparseVolume&);
+
+    bool parse(const char* data, size_t size, unsigned int body);
+    void canonicalize(const BlockRoi* roi);
+    void close();
+
+    //! mapped files (address, size)
+    std::vector<std::pair<const char*, size_t> > mappings;
+    //! stripe buffers owned by the volume (list keeps them in place)
+    std::list<std::vector<int> > buffers;
+    std::vector<unsigned long long> body_ids;
+
+    //! merged rows that do not fit in the mapped file
+    std::vector<Segment> owned_segments;
+    unsigned long long removed_segments;
+    unsigned long long clipped_voxels;
+
+    //! all stripes sorted by (z, y)
+    std::vector<Stripe> stripes;
+
+    //! z of each plane and offsets of each plane into stripes
+    std::vector<int> plane_z;
+    std::vector<size_t> plane_offsets;
+};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "StripeReader.h"
+
+#include <algorithm>
+#include <iostream>
+
+using std::string;
+using std::vector;
+
+namespace DVIDLoadSparse {
+
+bool StripeReader::open(string filename, string& error)
+{
+    if (filename == "-") {
+        in = &std::cin;
+    } else {
+        fin.open(filename.c_str(), std::ios::binary);
+        if (!fin) {
+            error = "cannot be opened";
+            return false;
+        }
+        in = &fin;
+    }
+    if (!in->read((char*) &remaining, sizeof(int)) || remaining < 0) {
+        error = "is truncated";
+        return false;
+    }
+    return read_header(error);
+}
+
+bool StripeReader::read_header(string& error)
+{
+    have_pending = false;
+    if (remaining == 0) {
+        return true;
+    }
+    if (!in->read((char*) pending, sizeof(pending)) || pending[2] < 0) {
+        error = "is truncated";
+        return false;
+    }
+    --remaining;
+    have_pending = true;
+    return true;
+}
+
+bool StripeReader::read_window(int z_begin, int z_end, vector<int>& buffer,
+        string& error)
+{
+    buffer.assign(1, 0);
+    while (have_pending && pending[0] < z_end) {
+        if (pending[0] < z_begin) {
+            error = "is not sorted by z";
+            return false;
+        }
+        size_t pos = buffer.size();
+        buffer.resize(pos + 3 + 2 * (size_t) pending[2]);
+        std::copy(pending, pending + 3, &buffer[pos]);
+        if (pending[2] > 0 && !in->read((char*) &buffer[pos + 3],
+                    2 * sizeof(int) * (size_t) pending[2])) {
+            error = "is truncated";
+            return false;
+        }
+        ++buffer[0];
+        if (!read_header(error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,71 @@
+/*!
+ * Sequential reader for sparse files whose stripes are sorted by z
+ * (as written by our exporters).  Stripes are read one z window at
+ * a time so that a body can be loaded with memory bounded by the
+ * window rather than the file.  The file is never rewound, so it
+ * can be a pipe or standard input.
+*/
+
+#ifndef STRIPEREADER_H
+#define STRIPEREADER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+class StripeReader {
+  public:
+    StripeReader() : in(0), remaining(0), have_pending(false) {}
+
+    /*!
+     * Open a sparse file ("-" for standard input) and read its first
+     * stripe header.
+     * \return false if the file cannot be opened or is truncated
+    */
+    bool open(std::string filename, std::string& error);
+
+    //! true once every stripe has been read
+    bool done() const
+    {
+        return !have_pending;
+    }
+
+    //! z of the next unread stripe (only valid if not done)
+    int next_z() const
+    {
+        return pending[0];
+    }
+
+    /*!
+     * Read the stripes in [z_begin, z_end) into buffer in sparse file
+     * layout (stripe count followed by stripes).  Windows must be
+     * requested in increasing z.
+     * \param z_begin first z of the window
+     * \param z_end z after the window
+     * \param buffer replaced by the window's stripes
+     * \param error set if reading fails
+     * \return false if the file is truncated or not sorted by z
+    */
+    bool read_window(int z_begin, int z_end, std::vector<int>& buffer,
+            std::string& error);
+
+  private:
+    bool read_header(std::string& error);
+
+    std::ifstream fin;
+    //! fin or standard input
+    std::istream* in;
+
+    //! stripes not yet read (excluding the pending one)
+    int remaining;
+
+    //! header (z, y, num_segments) of the next stripe
+    int pending[3];
+    bool have_pending;
+};
+
+}
+
+#endif
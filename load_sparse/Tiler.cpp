@@ -0,0 +1,196 @@
+#include "Tiler.h"
+
+#include <algorithm>
+#include <climits>
+
+using std::vector;
+
+namespace DVIDLoadSparse {
+
+bool Tiler::cell_less_x(const Cell& c1, const Cell& c2)
+{
+    return (c1.x < c2.x) || ((c1.x == c2.x) && (c1.y < c2.y));
+}
+
+bool Tiler::cell_less_y(const Cell& c1, const Cell& c2)
+{
+    return (c1.y < c2.y) || ((c1.y == c2.y) && (c1.x < c2.x));
+}
+
+bool Tiler::cell_equal(const Cell& c1, const Cell& c2)
+{
+    return (c1.x == c2.x) && (c1.y == c2.y);
+}
+
+void Tiler::tile_chunks(const SparseVolume& volume, const vector<Chunk>& chunks,
+        vector<Chunk>& tiles) const
+{
+    vector<Cell> cells;
+    vector<CellBox> boxes;
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+        cells.clear();
+        boxes.clear();
+        occupied_cells(volume, chunks[i], cells);
+        split_cells(cells, chunks[i].depth(), boxes);
+
+        for (unsigned int j = 0; j < boxes.size(); ++j) {
+            Chunk tile;
+            if (make_tile(volume, chunks[i], boxes[j], tile)) {
+                tiles.push_back(tile);
+            }
+        }
+    }
+}
+
+void Tiler::occupied_cells(const SparseVolume& volume, const Chunk& chunk,
+        vector<Cell>& cells) const
+{
+    for (size_t plane = chunk.plane_begin; plane != chunk.plane_end; ++plane) {
+        for (size_t s = volume.plane_begin(plane); s != volume.plane_end(plane); ++s) {
+            const Stripe& stripe = volume.get_stripe(s);
+            Cell cell;
+            cell.y = floor_div(stripe.y, cell_size);
+            for (unsigned int i = 0; i < stripe.num_segments; ++i) {
+                int cx2 = floor_div(stripe.segments[i].x2, cell_size);
+                for (cell.x = floor_div(stripe.segments[i].x1, cell_size);
+                        cell.x <= cx2; ++cell.x) {
+                    cells.push_back(cell);
+                }
+            }
+        }
+        
+        // keep the list compact for bodies with many planes per chunk
+        std::sort(cells.begin(), cells.end(), cell_less_y);
+        cells.erase(std::unique(cells.begin(), cells.end(), cell_equal), cells.end());
+    }
+}
+
+double Tiler::box_cost(const CellBox& box, unsigned long long depth) const
+{
+    double voxels = double(box.x2 - box.x1 + 1) * (box.y2 - box.y1 + 1) *
+        cell_size * cell_size * depth;
+    return 2 * (request_cost + voxels * sizeof(unsigned long long));
+}
+
+void Tiler::split_cells(vector<Cell>& cells, unsigned long long depth,
+        vector<CellBox>& boxes) const
+{
+    if (cells.empty()) {
+        return;
+    }
+
+    // bounding boxes of cell prefixes and suffixes for split search
+    vector<CellBox> prefix, suffix;
+
+    // ranges of cells still to be examined
+    vector<std::pair<size_t, size_t> > ranges;
+    ranges.push_back(std::make_pair(0, cells.size()));
+    while (!ranges.empty()) {
+        size_t begin = ranges.back().first;
+        size_t end = ranges.back().second;
+        ranges.pop_back();
+        size_t num = end - begin;
+
+        CellBox box = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+        for (size_t i = begin; i < end; ++i) {
+            box.x1 = std::min(box.x1, cells[i].x); box.x2 = std::max(box.x2, cells[i].x);
+            box.y1 = std::min(box.y1, cells[i].y); box.y2 = std::max(box.y2, cells[i].y);
+        }
+        
+        double best_cost = box_cost(box, depth);
+        int best_axis = -1;
+        size_t best_split = 0;
+
+        for (int axis = 0; axis < 2; ++axis) {
+            if (axis == 0) {
+                std::sort(cells.begin() + begin, cells.begin() + end, cell_less_x);
+            } else {
+                std::sort(cells.begin() + begin, cells.begin() + end, cell_less_y);
+            }
+            
+            prefix.resize(num);
+            suffix.resize(num);
+            CellBox running = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+            for (size_t i = 0; i < num; ++i) {
+                const Cell& cell = cells[begin + i];
+                running.x1 = std::min(running.x1, cell.x); running.x2 = std::max(running.x2, cell.x);
+                running.y1 = std::min(running.y1, cell.y); running.y2 = std::max(running.y2, cell.y);
+                prefix[i] = running;
+            }
+            running.x1 = INT_MAX; running.y1 = INT_MAX;
+            running.x2 = INT_MIN; running.y2 = INT_MIN;
+            for (size_t i = num; i-- > 0;) {
+                const Cell& cell = cells[begin + i];
+                running.x1 = std::min(running.x1, cell.x); running.x2 = std::max(running.x2, cell.x);
+                running.y1 = std::min(running.y1, cell.y); running.y2 = std::max(running.y2, cell.y);
+                suffix[i] = running;
+            }
+
+            // only cut between distinct coordinates so boxes stay disjoint
+            for (size_t i = 1; i < num; ++i) {
+                int prev = (axis == 0) ? cells[begin + i - 1].x : cells[begin + i - 1].y;
+                int curr = (axis == 0) ? cells[begin + i].x : cells[begin + i].y;
+                if (prev == curr) {
+                    continue;
+                }
+                double cost = box_cost(prefix[i-1], depth) + box_cost(suffix[i], depth);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = i;
+                }
+            }
+        }
+
+        if (best_axis == -1) {
+            boxes.push_back(box);
+            continue;
+        }
+        if (best_axis == 0) {
+            std::sort(cells.begin() + begin, cells.begin() + end, cell_less_x);
+        }
+        ranges.push_back(std::make_pair(begin + best_split, end));
+        ranges.push_back(std::make_pair(begin, begin + best_split));
+    }
+}
+
+bool Tiler::make_tile(const SparseVolume& volume, const Chunk& chunk,
+        const CellBox& box, Chunk& tile) const
+{
+    tile = chunk;
+    tile.x1 = box.x1 * cell_size;
+    tile.y1 = box.y1 * cell_size;
+    tile.x2 = (box.x2 + 1) * cell_size - 1;
+    tile.y2 = (box.y2 + 1) * cell_size - 1;
+    if (align_tiles) {
+        return true;
+    }
+
+    // shrink to the segments inside the cells
+    int minx = INT_MAX, miny = INT_MAX, maxx = INT_MIN, maxy = INT_MIN;
+    for (size_t plane = chunk.plane_begin; plane != chunk.plane_end; ++plane) {
+        for (size_t s = volume.row_lower_bound(plane, tile.y1);
+                s != volume.plane_end(plane); ++s) {
+            const Stripe& stripe = volume.get_stripe(s);
+            if (stripe.y > tile.y2) {
+                break;
+            }
+            for (unsigned int i = 0; i < stripe.num_segments; ++i) {
+                int x1 = std::max(stripe.segments[i].x1, tile.x1);
+                int x2 = std::min(stripe.segments[i].x2, tile.x2);
+                if (x1 <= x2) {
+                    minx = std::min(minx, x1); maxx = std::max(maxx, x2);
+                    miny = std::min(miny, stripe.y); maxy = std::max(maxy, stripe.y);
+                }
+            }
+        }
+    }
+    if (minx > maxx) {
+        return false;
+    }
+    tile.x1 = minx; tile.x2 = maxx;
+    tile.y1 = miny; tile.y2 = maxy;
+    return true;
+}
+
+}
@@ -0,0 +1,66 @@
+/*!
+ * Splits chunks into a small set of tight sub-rectangles (tiles)
+ * that cover their segments, so that large empty areas of a
+ * plane's bounding box are neither fetched nor written.
+*/
+
+#ifndef TILER_H
+#define TILER_H
+
+#include "ChunkLoader.h"
+
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+class Tiler {
+  public:
+    /*!
+     * \param cell_size granularity of the tiling (DVID block size)
+     * \param request_cost overhead of one request in equivalent bytes
+     * \param align_tiles snap tiles to cells; otherwise tiles are
+     * shrunk to the segments they contain
+    */
+    Tiler(int cell_size_, double request_cost_, bool align_tiles_) :
+        cell_size(cell_size_), request_cost(request_cost_),
+        align_tiles(align_tiles_) {}
+
+    /*!
+     * Replace each chunk with its tiles.  A chunk's xy footprint is
+     * rasterized into occupied cells and the cells' bounding box is
+     * split recursively along x or y wherever the two child boxes
+     * cost less than the parent, with the cost of a box being two
+     * requests (fetch and write) plus the label bytes moved.
+     * The z range and planes of a tile are those of its chunk.
+    */
+    void tile_chunks(const SparseVolume& volume, const std::vector<Chunk>& chunks,
+            std::vector<Chunk>& tiles) const;
+
+  private:
+    struct Cell {
+        int x, y;
+    };
+    struct CellBox {
+        int x1, y1, x2, y2;
+    };
+
+    static bool cell_less_x(const Cell& c1, const Cell& c2);
+    static bool cell_less_y(const Cell& c1, const Cell& c2);
+    static bool cell_equal(const Cell& c1, const Cell& c2);
+
+    void occupied_cells(const SparseVolume& volume, const Chunk& chunk,
+            std::vector<Cell>& cells) const;
+    double box_cost(const CellBox& box, unsigned long long depth) const;
+    void split_cells(std::vector<Cell>& cells, unsigned long long depth,
+            std::vector<CellBox>& boxes) const;
+    bool make_tile(const SparseVolume& volume, const Chunk& chunk,
+            const CellBox& box, Chunk& tile) const;
+
+    int cell_size;
+    double request_cost;
+    bool align_tiles;
+};
+
+}
+
+#endif
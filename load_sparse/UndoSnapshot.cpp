@@ -0,0 +1,218 @@
+#include "UndoSnapshot.h"
+
+#include <lz4.h>
+#include <tr1/unordered_map>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::ifstream;
+using std::tr1::unordered_map;
+
+namespace DVIDLoadSparse {
+
+static const char UNDO_MAGIC[8] = { 'D', 'L', 'S', 'U', 'N', 'D', 'O', '1' };
+
+static const size_t ROW_HEADER_SIZE = 3 * sizeof(int);
+static const size_t RUN_SIZE = 2 * sizeof(int) + sizeof(unsigned long long);
+
+static void append_bytes(vector<char>& buffer, const void* data, size_t size)
+{
+    const char* bytes = (const char*) data;
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+UndoSnapshot::~UndoSnapshot()
+{
+    if (fd >= 0) {
+        try {
+            flush();
+        } catch (std::exception&) {
+            // reported by the explicit flush at the end of a load
+        }
+        ::close(fd);
+    }
+}
+
+bool UndoSnapshot::create(string filename, string& error)
+{
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, UNDO_MAGIC, sizeof(UNDO_MAGIC)) != (ssize_t) sizeof(UNDO_MAGIC)) {
+        error = strerror(errno);
+        return false;
+    }
+    file_bytes = sizeof(UNDO_MAGIC);
+    return true;
+}
+
+void UndoSnapshot::add_row(vector<char>& records, int z, int y,
+        const vector<UndoRun>& runs)
+{
+    int header[3] = { z, y, (int) runs.size() };
+    append_bytes(records, header, sizeof(header));
+    for (unsigned int i = 0; i < runs.size(); ++i) {
+        append_bytes(records, &runs[i].x1, sizeof(int));
+        append_bytes(records, &runs[i].x2, sizeof(int));
+        append_bytes(records, &runs[i].label, sizeof(unsigned long long));
+    }
+}
+
+void UndoSnapshot::append(const vector<char>& records, unsigned long long runs)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    pending.insert(pending.end(), records.begin(), records.end());
+    num_runs += runs;
+    if (pending.size() >= block_size) {
+        flush_locked();
+    }
+}
+
+void UndoSnapshot::flush()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    flush_locked();
+}
+
+void UndoSnapshot::flush_locked()
+{
+    if (pending.empty()) {
+        return;
+    }
+    // blocks hold whole records, so a block is only this large if a
+    // single chunk's records are
+    if (pending.size() > (size_t) LZ4_MAX_INPUT_SIZE) {
+        throw std::runtime_error("undo records of a chunk exceed the lz4 block limit");
+    }
+
+    unsigned int header[2];
+    header[0] = pending.size();
+    compressed.resize(sizeof(header) + LZ4_compressBound(pending.size()));
+    header[1] = LZ4_compress_default(&pending[0], &compressed[sizeof(header)],
+            pending.size(), compressed.size() - sizeof(header));
+    memcpy(&compressed[0], header, sizeof(header));
+
+    size_t size = sizeof(header) + header[1];
+    const char* data = &compressed[0];
+    file_bytes += size;
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(string("undo snapshot write failed: ") + strerror(errno));
+        }
+        data += written;
+        size -= written;
+    }
+    pending.clear();
+}
+
+bool UndoSnapshot::read(string filename, vector<unsigned long long>& labels,
+        vector<vector<int> >& buffers, bool& torn, string& error)
+{
+    ifstream fin(filename.c_str(), std::ios::binary);
+    if (!fin) {
+        error = "cannot be opened";
+        return false;
+    }
+    char magic[8];
+    if (!fin.read(magic, sizeof(magic)) || memcmp(magic, UNDO_MAGIC, sizeof(magic)) != 0) {
+        error = "not an undo snapshot";
+        return false;
+    }
+
+    // per label: position of the row being filled and the record it
+    // came from
+    unordered_map<unsigned long long, size_t> label2index;
+    vector<size_t> row_pos;
+    vector<unsigned long long> row_record;
+    unsigned long long record = 0;
+    const unsigned long long NO_RECORD = (unsigned long long) -1;
+
+    vector<char> block, raw;
+    torn = false;
+    while (true) {
+        unsigned int header[2];
+        fin.read((char*) header, sizeof(header));
+        if (fin.gcount() == 0) {
+            break;
+        }
+        if (fin.gcount() != (std::streamsize) sizeof(header) || header[1] == 0) {
+            torn = true;
+            break;
+        }
+        block.resize(header[1]);
+        if (!fin.read(&block[0], header[1])) {
+            // the load stopped while writing this block
+            torn = true;
+            break;
+        }
+        raw.resize(header[0]);
+        if (header[0] == 0 || LZ4_decompress_safe(&block[0], &raw[0], header[1],
+                    header[0]) != (int) header[0]) {
+            error = "corrupt block";
+            return false;
+        }
+
+        size_t pos = 0;
+        while (pos < raw.size()) {
+            int row[3];
+            if (raw.size() - pos < ROW_HEADER_SIZE) {
+                error = "corrupt record";
+                return false;
+            }
+            memcpy(row, &raw[pos], ROW_HEADER_SIZE);
+            pos += ROW_HEADER_SIZE;
+            if (row[2] < 0 || (raw.size() - pos) / RUN_SIZE < (size_t) row[2]) {
+                error = "corrupt record";
+                return false;
+            }
+
+            for (int i = 0; i < row[2]; ++i) {
+                int x[2];
+                unsigned long long label;
+                memcpy(x, &raw[pos], sizeof(x));
+                memcpy(&label, &raw[pos + sizeof(x)], sizeof(label));
+                pos += RUN_SIZE;
+
+                unordered_map<unsigned long long, size_t>::iterator iter =
+                    label2index.find(label);
+                size_t index;
+                if (iter == label2index.end()) {
+                    index = labels.size();
+                    label2index[label] = index;
+                    labels.push_back(label);
+                    buffers.push_back(vector<int>(1, 0));
+                    row_pos.push_back(0);
+                    row_record.push_back(NO_RECORD);
+                } else {
+                    index = iter->second;
+                }
+
+                // start a row of this label's stripes
+                vector<int>& buffer = buffers[index];
+                if (row_record[index] != record) {
+                    row_record[index] = record;
+                    row_pos[index] = buffer.size();
+                    buffer.push_back(row[0]);
+                    buffer.push_back(row[1]);
+                    buffer.push_back(0);
+                    ++buffer[0];
+                }
+                buffer.push_back(x[0]);
+                buffer.push_back(x[1]);
+                ++buffer[row_pos[index] + 2];
+            }
+            ++record;
+        }
+    }
+    return true;
+}
+
+}
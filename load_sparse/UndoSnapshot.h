@@ -0,0 +1,100 @@
+/*!
+ * Undo snapshot of the labels a load overwrites.  Before a chunk is
+ * relabeled, the fetched labels under its segments are recorded as
+ * runs of constant label, so the snapshot is about as compact as
+ * the sparse input.  Rolling back loads every old label as a body
+ * through the usual chunk engine.
+ *
+ * File layout: an 8-byte magic string followed by lz4 blocks, each
+ * a uint32 raw size and uint32 compressed size then the compressed
+ * records:
+ *
+ *   int32 z, int32 y, int32 num_runs,
+ *   num_runs x (int32 x1, int32 x2, uint64 label)
+*/
+
+#ifndef UNDOSNAPSHOT_H
+#define UNDOSNAPSHOT_H
+
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSparse {
+
+//! inclusive x range that held one label
+struct UndoRun {
+    int x1, x2;
+    unsigned long long label;
+};
+
+class UndoSnapshot {
+  public:
+    /*!
+     * \param block_size_ raw bytes compressed per block
+    */
+    UndoSnapshot(size_t block_size_ = 1 << 20) : fd(-1), block_size(block_size_),
+        file_bytes(0), num_runs(0) {}
+    ~UndoSnapshot();
+
+    /*!
+     * Create (or truncate) the snapshot file.
+     * \return false if the file cannot be written
+    */
+    bool create(std::string filename, std::string& error);
+
+    /*!
+     * Append the runs of one row to a record buffer.
+    */
+    static void add_row(std::vector<char>& records, int z, int y,
+            const std::vector<UndoRun>& runs);
+
+    /*!
+     * Add the records of a chunk (thread-safe).  Throws
+     * std::runtime_error if the snapshot cannot be written.
+    */
+    void append(const std::vector<char>& records, unsigned long long runs);
+
+    //! compress and write buffered records
+    void flush();
+
+    //! bytes written to the snapshot file
+    unsigned long long get_file_bytes() const
+    {
+        return file_bytes;
+    }
+
+    unsigned long long get_num_runs() const
+    {
+        return num_runs;
+    }
+
+    /*!
+     * Read a snapshot as one sparse volume buffer (see
+     * SparseVolume::add_body_buffer) per old label.
+     * \param filename snapshot file
+     * \param labels old labels
+     * \param buffers stripes restoring each label
+     * \param torn set if the last block is incomplete (it is skipped)
+     * \param error reason for failure
+     * \return false if the file cannot be read or is not a snapshot
+    */
+    static bool read(std::string filename, std::vector<unsigned long long>& labels,
+            std::vector<std::vector<int> >& buffers, bool& torn, std::string& error);
+
+  private:
+    void flush_locked();
+
+    int fd;
+    size_t block_size;
+    unsigned long long file_bytes;
+    unsigned long long num_runs;
+
+    std::vector<char> pending;
+    std::vector<char> compressed;
+    boost::mutex mutex;
+};
+
+}
+
+#endif
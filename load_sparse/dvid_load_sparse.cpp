@@ -1,137 +1,700 @@
+#include "SparseVolume.h"
+#include "ChunkLoader.h"
+#include "ChunkPipeline.h"
+#include "Tiler.h"
+#include "CoveragePlanner.h"
+#include "ChunkOrder.h"
+#include "BlockRoi.h"
+#include "Journal.h"
+#include "RleWriter.h"
+#include "StripeReader.h"
+#include "UndoSnapshot.h"
+#include "OptionParser.h"
+
 #include <libdvid/DVIDNodeService.h>
+#include <boost/shared_ptr.hpp>
 
 #include <iostream>
 #include <string>
-#include <fstream>
-
 #include <vector>
-#include <tr1/unordered_map>
-#include <tr1/unordered_set>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
 
 using std::cout; using std::endl;
 using std::ifstream;
-
 using std::string;
-using std::tr1::unordered_map;
-using std::tr1::unordered_set;
 using std::vector;
-using std::pair;
-using std::make_pair;
-using std::cin;
 
-const char * USAGE = "<prog> <dvid-server> <uuid> <label name> <sparse file> <body ID>";
+using namespace DVIDLoadSparse;
+
 const char * HELP = "Program takes a sparse volume and loads it into DVID";
 
-int read_int(ifstream& fin)
+/*!
+ * Read (sparse file, body ID) pairs from a manifest.
+ * \return false if the manifest cannot be opened or a line is malformed
+*/
+bool read_manifest(string manifest, vector<string>& files,
+        vector<unsigned long long>& body_ids)
+{
+    ifstream fin(manifest.c_str());
+    if (!fin) {
+        return false;
+    }
+    string line;
+    while (std::getline(fin, line)) {
+        std::istringstream sstr(line);
+        string file;
+        unsigned long long body_id;
+        if (!(sstr >> file)) {
+            continue; // blank line
+        }
+        if (!(sstr >> body_id)) {
+            return false;
+        }
+        files.push_back(file);
+        body_ids.push_back(body_id);
+    }
+    return true;
+}
+
+struct BuildOptions
+{
+    BuildOptions(int argc, char** argv) : overlap_policy("last"),
+        chunk_depth(1), block_size(32), threads(1), inflight(0),
+        tile(false), request_cost(262144), write_only_covered(false),
+        compress(false), resume(false),
+        rle(false), rle_max_spans(0),
+        stream(false), stream_depth(0), only_if_background(false),
+        order("morton"), cache_blocks(4096)
+    {
+        DVIDUtils::OptionParser parser(HELP);
+
+        parser.add_positional(dvid_servername, "dvid-server", "name of dvid server");
+        parser.add_positional(uuid, "uuid", "dvid node uuid");
+        parser.add_positional(label_name, "label-name", "name of the label volume");
+        parser.add_positional(sparse_file, "sparse-file",
+                "sparse volume file, '-' for standard input (omit with --manifest)",
+                false);
+        parser.add_positional(body_id, "body-id",
+                "body ID to write (omit with --manifest)", false);
+
+        parser.add_option(manifest, "manifest",
+                "text file with one '<sparse file> <body ID>' pair per line; "
+                "all bodies are loaded together");
+        parser.add_option(overlap_policy, "overlap-policy",
+                "body kept where manifest bodies overlap: 'last' (as if loaded "
+                "in manifest order) or 'first'");
+
+        parser.add_option(roi, "roi",
+                "only write inside this DVID ROI (blocks of block-size)");
+        parser.add_option(roi_file, "roi-file",
+                "only write inside the ROI in this file, a JSON array of "
+                "[z, y, x0, x1] block spans as returned by DVID");
+
+        parser.add_option(chunk_depth, "chunk-depth",
+                "z depth of each read-modify-write; 1 loads plane by plane, "
+                "otherwise a multiple of block-size (e.g. 32 or 64) loads "
+                "block-aligned subvolumes");
+        parser.add_option(block_size, "block-size", "DVID block size");
+        parser.add_flag(tile, "tile",
+                "fetch and write only tight rectangles around the segments "
+                "instead of whole chunk bounding boxes");
+        parser.add_option(request_cost, "request-cost",
+                "overhead of one request in equivalent bytes, used to trade "
+                "request count against wasted bytes when tiling");
+        parser.add_flag(write_only_covered, "write-only-covered",
+                "write regions the body covers completely without fetching them; "
+                "block-aligned chunks are split into covered and partly covered blocks");
+        parser.add_flag(compress, "compress",
+                "transfer labels lz4 compressed for both reads and writes");
+        parser.add_option(journal, "journal",
+                "file recording committed chunks so an interrupted load can be resumed");
+        parser.add_flag(resume, "resume",
+                "skip chunks already committed in the journal");
+        parser.add_flag(rle, "rle",
+                "post each body as a DVID sparse volume (RLE spans) instead of "
+                "read-modify-writing label subvolumes");
+        parser.add_option(rle_endpoint, "rle-endpoint",
+                "endpoint under the label instance that accepts sparse volume "
+                "POSTs, required with rle; the body ID is appended");
+        parser.add_option(rle_max_spans, "rle-max-spans",
+                "spans per sparse volume request (0 posts each body at once, "
+                "split only above the 2^32-1 spans a request can hold)");
+        parser.add_option(order, "order",
+                "order in which chunks are loaded: 'morton' (Z-order curve over "
+                "blocks, for block cache reuse) or 'plan' (by z)");
+        parser.add_option(cache_blocks, "cache-blocks",
+                "blocks in the modeled server cache used to report block reuse");
+        parser.add_option(threads, "threads",
+                "number of concurrent fetch and write requests; 1 runs serially");
+        parser.add_option(inflight, "inflight",
+                "maximum chunks held in memory between fetch and write "
+                "(0 uses twice the number of threads)");
+        parser.add_option(only_if_label, "only-if-label",
+                "only overwrite voxels that currently hold this label");
+        parser.add_flag(only_if_background, "only-if-background",
+                "only overwrite voxels that currently hold label 0 (with "
+                "only-if-label, voxels holding either label are overwritten)");
+        parser.add_option(undo, "undo",
+                "save the labels being overwritten to this snapshot file");
+        parser.add_option(rollback, "rollback",
+                "restore the labels saved in an undo snapshot (instead of "
+                "loading a sparse file or manifest)");
+        parser.add_flag(stream, "stream",
+                "read z-sorted sparse files a window of planes at a time and "
+                "load each window before reading the next, bounding memory "
+                "by the window size; with '-' as input, loading overlaps the "
+                "export that writes it (no journal or rle)");
+        parser.add_option(stream_depth, "stream-depth",
+                "z depth of a stream window, a multiple of chunk-depth "
+                "(0 uses the larger of chunk-depth and block-size)");
+
+        parser.parse_options(argc, argv);
+    }
+
+    string dvid_servername;
+    string uuid;
+    string label_name;
+    string sparse_file;
+    string body_id;
+    string manifest;
+    string overlap_policy;
+
+    int chunk_depth;
+    int block_size;
+    int threads;
+    int inflight;
+
+    bool tile;
+    double request_cost;
+    bool write_only_covered;
+    bool compress;
+
+    string journal;
+    bool resume;
+
+    bool rle;
+    string rle_endpoint;
+    unsigned long long rle_max_spans;
+
+    bool stream;
+    int stream_depth;
+
+    string only_if_label;
+    bool only_if_background;
+
+    string undo;
+    string rollback;
+
+    string order;
+    int cache_blocks;
+
+    string roi;
+    string roi_file;
+};
+
+/*!
+ * Split chunks into tiles and write-only regions as requested.
+ * \param verbose report how the chunks were split
+*/
+void refine_chunks(const BuildOptions& options, const SparseVolume& volume,
+        vector<Chunk>& chunks, bool verbose)
+{
+    // only load rectangles around the segments
+    if (options.tile) {
+        Tiler tiler(options.block_size, options.request_cost, options.chunk_depth > 1);
+        vector<Chunk> tiles;
+        tiler.tile_chunks(volume, chunks, tiles);
+        if (verbose) {
+            cout << "Split " << chunks.size() << " chunks into " << tiles.size()
+                << " tiles" << endl;
+        }
+        chunks.swap(tiles);
+    }
+
+    // skip reads where the bodies overwrite everything
+    if (options.write_only_covered) {
+        CoveragePlanner planner(options.block_size, options.request_cost,
+                options.chunk_depth > 1);
+        vector<Chunk> split;
+        planner.split_chunks(volume, chunks, split);
+        chunks.swap(split);
+    }
+}
+
+/*!
+ * Put chunks in the requested load order.  Both the plan order and
+ * the chosen order are replayed through block cache models so that
+ * their block reuse can be compared.
+*/
+void schedule_chunks(const BuildOptions& options, vector<Chunk>& chunks,
+        BlockCacheModel& plan_cache, BlockCacheModel& order_cache)
 {
-    char buffer[4]; // reading signed ints
-    fin.read(buffer, 4);
-    return *((int*) buffer);
+    plan_cache.touch_chunks(chunks);
+    if (options.order == "morton") {
+        morton_order(chunks, options.block_size);
+    }
+    order_cache.touch_chunks(chunks);
+}
+
+void print_cache_reuse(const BuildOptions& options, const BlockCacheModel& plan_cache,
+        const BlockCacheModel& order_cache)
+{
+    cout << "Block cache hit rate (" << options.cache_blocks << " blocks, "
+        << order_cache.get_touches() << " block touches): " << options.order
+        << " order " << 100 * order_cache.hit_rate() << "%";
+    if (options.order != "plan") {
+        cout << " (plan order " << 100 * plan_cache.hit_rate() << "%)";
+    }
+    cout << endl;
+}
+
+/*!
+ * Load each subvolume, relabel sparsely, and write back.  Chunks
+ * go through the pipeline when one is given, otherwise they are
+ * loaded one at a time.
+*/
+void load_chunks(const ChunkLoader& loader, libdvid::DVIDNodeService& dvid_node,
+        ChunkPipeline* pipeline, const SparseVolume& volume,
+        const vector<Chunk>& chunks, Journal* journal, LoadStats& stats)
+{
+    if (pipeline) {
+        pipeline->run(volume, chunks, stats);
+        return;
+    }
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+        loader.load_chunk(dvid_node, volume, chunks[i], stats);
+        if (journal) {
+            journal->commit(chunks[i].id);
+        }
+    }
+}
+
+/*!
+ * Write out the rest of the undo snapshot.  This is also done when
+ * a load fails, since every chunk written so far has been recorded.
+*/
+void finish_snapshot(UndoSnapshot* snapshot, string filename)
+{
+    if (!snapshot) {
+        return;
+    }
+    try {
+        snapshot->flush();
+    } catch (std::exception& e) {
+        cout << "Error: undo snapshot: " << filename << ": " << e.what() << endl;
+        exit(1);
+    }
+    cout << "Saved undo snapshot: " << snapshot->get_num_runs() << " runs in "
+        << snapshot->get_file_bytes() << " bytes" << endl;
+}
+
+/*!
+ * Load z-sorted sparse files one window of planes at a time.  Only
+ * the stripes of the current window are held in memory, and writes
+ * start once the first window has been read.  Windows are aligned
+ * to the chunk depth, so they produce the same chunks as a full load.
+ * \param roi region the bodies are clipped to (optional)
+ * \param num_planes planes loaded
+ * \param num_chunks chunks loaded
+*/
+void stream_load(const BuildOptions& options, const vector<string>& files,
+        const vector<unsigned long long>& body_ids, const ChunkLoader& loader,
+        libdvid::DVIDNodeService& dvid_node, ChunkPipeline* pipeline,
+        const BlockRoi* roi, LoadStats& stats, size_t& num_planes, size_t& num_chunks)
+{
+    // the cache models carry over between windows
+    BlockCacheModel plan_cache(options.cache_blocks, options.block_size);
+    BlockCacheModel order_cache(options.cache_blocks, options.block_size);
+
+    // ifstream is not copyable
+    vector<boost::shared_ptr<StripeReader> > readers;
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        string error;
+        readers.push_back(boost::shared_ptr<StripeReader>(new StripeReader));
+        if (!readers.back()->open(files[i], error)) {
+            cout << "Error: input file: " << files[i] << " " << error << endl;
+            exit(1);
+        }
+    }
+
+    unsigned long long removed_segments = 0;
+    unsigned long long clipped_voxels = 0;
+    unsigned long long overlap_voxels = 0;
+    size_t num_windows = 0;
+    size_t max_window_stripes = 0;
+    unsigned long long max_window_bytes = 0;
+
+    while (true) {
+        // the next window starts at the lowest unread plane
+        bool found = false;
+        int z = 0;
+        for (unsigned int i = 0; i < readers.size(); ++i) {
+            if (!readers[i]->done() && (!found || readers[i]->next_z() < z)) {
+                z = readers[i]->next_z();
+                found = true;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        int z_begin = align_down(z, options.stream_depth);
+        int z_end = z_begin + options.stream_depth;
+
+        // bodies are added in manifest order so overlaps resolve as
+        // in a full load
+        SparseVolume volume;
+        unsigned long long window_bytes = 0;
+        for (unsigned int i = 0; i < readers.size(); ++i) {
+            vector<int> buffer;
+            string error;
+            if (!readers[i]->read_window(z_begin, z_end, buffer, error)) {
+                cout << "Error: input file: " << files[i] << " " << error << endl;
+                exit(1);
+            }
+            if (buffer[0] == 0) {
+                continue;
+            }
+            window_bytes += buffer.size() * sizeof(int);
+            volume.add_body_buffer(buffer, body_ids[i]);
+        }
+        volume.build_index(roi);
+        removed_segments += volume.get_removed_segments();
+        clipped_voxels += volume.get_clipped_voxels();
+        if (volume.num_bodies() > 1) {
+            overlap_voxels += volume.overlap_voxels();
+        }
+
+        vector<Chunk> chunks;
+        plan_chunks(volume, options.block_size, options.chunk_depth, chunks, stats);
+        refine_chunks(options, volume, chunks, false);
+        schedule_chunks(options, chunks, plan_cache, order_cache);
+        load_chunks(loader, dvid_node, pipeline, volume, chunks, 0, stats);
+
+        num_planes += volume.num_planes();
+        num_chunks += chunks.size();
+        ++num_windows;
+        max_window_stripes = std::max(max_window_stripes, volume.num_stripes());
+        max_window_bytes = std::max(max_window_bytes, window_bytes);
+    }
+
+    if (removed_segments) {
+        cout << "Merged " << removed_segments << " duplicate or overlapping segments" << endl;
+    }
+    if (roi) {
+        cout << "Clipped " << clipped_voxels << " voxels outside the ROI" << endl;
+    }
+    if (files.size() > 1) {
+        cout << "Streamed " << files.size() << " bodies; " << overlap_voxels
+            << " voxels overlap between bodies" << endl;
+    }
+    cout << "Streamed " << num_windows << " windows of " << options.stream_depth
+        << " planes (largest: " << max_window_stripes << " stripes, "
+        << max_window_bytes << " bytes)" << endl;
+    print_cache_reuse(options, plan_cache, order_cache);
 }
 
 int main(int argc, char** argv)
 {
-    if (argc != 6) {
-        cout << USAGE << endl;
-        cout << HELP << endl;
+    BuildOptions options(argc, argv);
+    if (options.block_size <= 0 || options.chunk_depth <= 0 ||
+            (options.chunk_depth > 1 && (options.chunk_depth % options.block_size))) {
+        cout << "Error: chunk-depth must be 1 or a multiple of block-size" << endl;
+        exit(1);
+    }
+    if (options.request_cost < 0) {
+        cout << "Error: request-cost must be non-negative" << endl;
+        exit(1);
+    }
+    if (options.threads <= 0 || options.inflight < 0) {
+        cout << "Error: threads must be positive and inflight non-negative" << endl;
+        exit(1);
+    }
+    if (options.rle && options.rle_endpoint == "") {
+        cout << "Error: rle requires rle-endpoint (labelblk and labelarray "
+            "instances do not accept sparse volume writes)" << endl;
+        exit(1);
+    }
+    if (options.rle && options.journal != "") {
+        cout << "Error: rle writes are not journaled" << endl;
+        exit(1);
+    }
+    if (options.resume && options.journal == "") {
+        cout << "Error: resume requires a journal" << endl;
+        exit(1);
+    }
+    if (options.stream && (options.rle || options.journal != "")) {
+        cout << "Error: stream mode cannot be combined with rle or a journal" << endl;
+        exit(1);
+    }
+    if (options.stream_depth == 0) {
+        options.stream_depth = std::max(options.chunk_depth, options.block_size);
+    }
+    if (options.stream_depth < 0 || (options.stream_depth % options.chunk_depth)) {
+        cout << "Error: stream-depth must be a multiple of chunk-depth" << endl;
+        exit(1);
+    }
+    if (options.inflight == 0) {
+        options.inflight = 2 * options.threads;
+    }
+    if ((options.order != "morton" && options.order != "plan") || options.cache_blocks < 0) {
+        cout << "Error: order must be 'morton' or 'plan' and cache-blocks non-negative" << endl;
+        exit(1);
+    }
+
+    // restrict which voxels the bodies may overwrite
+    OverwriteCondition condition;
+    if (options.only_if_label != "" || options.only_if_background) {
+        if (options.rle || options.write_only_covered) {
+            cout << "Error: conditional overwrites need the current labels "
+                "(no rle or write-only-covered)" << endl;
+            exit(1);
+        }
+        condition.conditional = true;
+        if (options.only_if_label != "") {
+            condition.label1 = strtoull(options.only_if_label.c_str(), 0, 10);
+        }
+        condition.label2 = options.only_if_background ? 0 : condition.label1;
+    }
+    if (options.undo != "" && (options.rle || options.write_only_covered || options.resume)) {
+        cout << "Error: undo snapshots need the current labels of every chunk "
+            "(no rle, write-only-covered, or resume)" << endl;
+        exit(1);
+    }
+    if (options.rollback != "" && (options.manifest != "" || options.stream ||
+                options.rle || condition.conditional || options.rollback == options.undo)) {
+        cout << "Error: rollback restores a snapshot as is (no manifest, stream, rle, "
+            "conditions, or undo to the same file)" << endl;
+        exit(1);
+    }
+
+    // labels overwritten by this load
+    UndoSnapshot snapshot;
+    UndoSnapshot* snapshot_ptr = 0;
+    if (options.undo != "") {
+        string error;
+        if (!snapshot.create(options.undo, error)) {
+            cout << "Error: undo snapshot: " << options.undo << ": " << error << endl;
+            exit(1);
+        }
+        snapshot_ptr = &snapshot;
+    }
+    
+    if (options.roi != "" && options.roi_file != "") {
+        cout << "Error: give either roi or roi-file" << endl;
         exit(1);
     }
     
     // create DVID node accessor 
-    libdvid::DVIDNodeService dvid_node(argv[1], argv[2]);
-    string label_name = string(argv[3]);
+    libdvid::DVIDNodeService dvid_node(options.dvid_servername, options.uuid);
+
+    // region the writes are clipped to
+    BlockRoi roi(options.block_size);
+    BlockRoi* roi_ptr = 0;
+    if (options.roi != "") {
+        vector<libdvid::BlockXYZ> blocks;
+        try {
+            dvid_node.get_roi(options.roi, blocks);
+        } catch (std::exception& e) {
+            cout << "Error: roi: " << options.roi << ": " << e.what() << endl;
+            exit(1);
+        }
+        for (unsigned int i = 0; i < blocks.size(); ++i) {
+            roi.add_block(blocks[i].x, blocks[i].y, blocks[i].z);
+        }
+        roi_ptr = &roi;
+    } else if (options.roi_file != "") {
+        string error;
+        if (!roi.load_file(options.roi_file, error)) {
+            cout << "Error: roi file: " << options.roi_file << ": " << error << endl;
+            exit(1);
+        }
+        roi_ptr = &roi;
+    }
+    if (roi_ptr) {
+        roi.finalize();
+        cout << "ROI has " << roi.get_num_blocks() << " blocks" << endl;
+    }
   
-    ifstream fin(argv[4]);
-   
-    unsigned long long new_body_id = (unsigned long long)(atoi(argv[5])); 
-
-    // read sparse volume one at a time
-    int num_stripes = read_int(fin);
-    //cout << num_stripes << endl;
-    typedef vector<pair<int, int> > segments_t;
-    typedef unordered_map<int, segments_t> segmentsets_t;
-    typedef unordered_map<int, segmentsets_t > sparse_t; 
-    sparse_t plane2segments;
-    
-    for (int i = 0; i < num_stripes; ++i) {
-        int z = read_int(fin);         
-        int y = read_int(fin);
-        //cout << z << " " << y << endl; 
-        // will same z,y appear multiple times
-        segments_t segment_list;
-        int num_segments = read_int(fin);         
-        for (int j = 0; j < num_segments; ++j) {
-            int x1 = read_int(fin);         
-            int x2 = read_int(fin);         
-            segment_list.push_back(make_pair(x1, x2));
-        }
-        plane2segments[z][y] = segment_list;
-    }
-    fin.close();
-
-
-    //return 0;
-    // iterate each z, load appropriate slice of a given size, relabel sparsely
-    for (sparse_t::iterator iter = plane2segments.begin(); iter != plane2segments.end(); ++iter) {
-        // get bounds
-        int maxy = 0;
-        int miny = INT_MAX;
-        int maxx = 0;
-        int minx = INT_MAX;
-        for (segmentsets_t::iterator iter2 = iter->second.begin(); iter2 != iter->second.end(); ++iter2) {
-            if (iter2->first < miny) {
-                miny = iter2->first;
-            }
-            if (iter2->first > maxy) {
-                maxy = iter2->first;
-            }
-            segments_t& segment_list = iter2->second;
+    vector<string> files;
+    vector<unsigned long long> body_ids;
+    if (options.rollback != "") {
+        // bodies come from the snapshot
+    } else if (options.manifest != "") {
+        if (!read_manifest(options.manifest, files, body_ids)) {
+            cout << "Error: manifest: " << options.manifest << " cannot be read" << endl;
+            exit(1);
+        }
+    } else if (options.sparse_file != "" && options.body_id != "") {
+        files.push_back(options.sparse_file);
+        body_ids.push_back(strtoull(options.body_id.c_str(), 0, 10));
+    } else {
+        cout << "Error: a sparse file and body ID or a manifest must be given" << endl;
+        exit(1);
+    }
 
-            for (int i = 0; i < segment_list.size(); ++i) {
-                if (segment_list[i].first < minx) {
-                    minx = segment_list[i].first;
-                }
-                if (segment_list[i].second > maxx) {
-                    maxx = segment_list[i].second;
-                }
+    if (std::count(files.begin(), files.end(), string("-")) > 1) {
+        cout << "Error: standard input can only be read once" << endl;
+        exit(1);
+    }
+
+    // later bodies overwrite earlier ones, so reverse the manifest to
+    // keep the first body instead
+    if (options.overlap_policy == "first") {
+        std::reverse(files.begin(), files.end());
+        std::reverse(body_ids.begin(), body_ids.end());
+    } else if (options.overlap_policy != "last") {
+        cout << "Error: overlap-policy must be 'first' or 'last'" << endl;
+        exit(1);
+    }
+
+    // read and load a window of planes at a time
+    if (options.stream) {
+        ChunkLoader loader(options.label_name, options.block_size, options.compress,
+                condition, snapshot_ptr);
+        LoadStats stats;
+        size_t num_planes = 0, num_chunks = 0;
+        try {
+            // one pipeline (and set of connections) serves every window
+            boost::shared_ptr<ChunkPipeline> pipeline;
+            if (options.threads > 1) {
+                pipeline = boost::shared_ptr<ChunkPipeline>(new ChunkPipeline(
+                            options.dvid_servername, options.uuid, loader,
+                            options.threads, options.inflight));
             }
+            stream_load(options, files, body_ids, loader, dvid_node, pipeline.get(),
+                    roi_ptr, stats, num_planes, num_chunks);
+        } catch (std::exception& e) {
+            cout << "Error: load failed: " << e.what() << endl;
+            finish_snapshot(snapshot_ptr, options.undo);
+            exit(1);
+        }
+        finish_snapshot(snapshot_ptr, options.undo);
+        cout << "Loaded " << num_planes << " planes in " << num_chunks
+            << " chunks" << endl;
+        stats.print(cout);
+        return 0;
+    }
+
+    SparseVolume volume;
+    for (unsigned int i = 0; i < files.size(); ++i) {
+        if (!volume.add_body(files[i], body_ids[i])) {
+            cout << "Error: input file: " << files[i] << " cannot be opened or is truncated" << endl;
+            exit(1);
+        }
+    }
+
+    // each old label is written back like a body
+    if (options.rollback != "") {
+        vector<unsigned long long> labels;
+        vector<vector<int> > buffers;
+        bool torn;
+        string error;
+        if (!UndoSnapshot::read(options.rollback, labels, buffers, torn, error)) {
+            cout << "Error: undo snapshot: " << options.rollback << ": " << error << endl;
+            exit(1);
+        }
+        if (torn) {
+            cout << "Warning: undo snapshot ends in an incomplete block, which is skipped" << endl;
         }
-        //cout << "z: " << iter->first << " y: " << miny << " x: " << minx << endl;
-        //cout << maxx-minx+1 << "x" << maxy-miny+1 << "x1" << endl;
-
-        // create dvid size and start points (X, Y, Z)
-        libdvid::Dims_t sizes; sizes.push_back(maxx-minx+1);
-        sizes.push_back(maxy-miny+1); sizes.push_back(1);
-        
-        vector<unsigned int> start; start.push_back(minx);
-        start.push_back(miny); start.push_back(iter->first);
-
-        // retrieve dvid slice
-        libdvid::Labels3D label_data = dvid_node.get_labels3D(label_name, sizes, start, false);
-        
-        unsigned long long* ldata_raw = (unsigned long long*) label_data.get_raw();
-        int width = maxx-minx+1;
-
-        // rewrite body id in label data
-        for (segmentsets_t::iterator iter2 = iter->second.begin(); iter2 != iter->second.end(); ++iter2) {
-            segments_t& segment_list = iter2->second;
-            int offset = (iter2->first - miny)*width;
-            for (int i = 0; i < segment_list.size(); ++i) {
-                for (int j = segment_list[i].first; j <= segment_list[i].second; ++j) {
-                    ldata_raw[offset + (j-minx)] = new_body_id;
+        for (unsigned int i = 0; i < labels.size(); ++i) {
+            volume.add_body_buffer(buffers[i], labels[i]);
+        }
+        cout << "Restoring " << labels.size() << " labels from " << options.rollback << endl;
+    }
+    volume.build_index(roi_ptr);
+    if (volume.get_removed_segments()) {
+        cout << "Merged " << volume.get_removed_segments()
+            << " duplicate or overlapping segments" << endl;
+    }
+    if (roi_ptr) {
+        cout << "Clipped " << volume.get_clipped_voxels() << " voxels outside the ROI" << endl;
+    }
+    if (volume.num_bodies() > 1) {
+        cout << "Indexed " << volume.num_bodies() << " bodies; " << volume.overlap_voxels()
+            << " voxels overlap between bodies" << endl;
+    }
+
+    // group planes into subvolumes
+    LoadStats stats;
+    vector<Chunk> chunks;
+    plan_chunks(volume, options.block_size, options.chunk_depth, chunks, stats);
+
+    // spans go straight to DVID without touching label subvolumes
+    if (options.rle) {
+        RleWriter writer(options.label_name, options.rle_endpoint,
+                options.rle_max_spans, options.compress);
+        try {
+            writer.write_bodies(dvid_node, volume, stats);
+        } catch (std::exception& e) {
+            cout << "Error: load failed: " << e.what() << endl;
+            exit(1);
+        }
+        cout << "Loaded " << volume.num_bodies() << " bodies as sparse volumes" << endl;
+        stats.print(cout);
+        return 0;
+    }
+
+    refine_chunks(options, volume, chunks, true);
+    BlockCacheModel plan_cache(options.cache_blocks, options.block_size);
+    BlockCacheModel order_cache(options.cache_blocks, options.block_size);
+    schedule_chunks(options, chunks, plan_cache, order_cache);
+    print_cache_reuse(options, plan_cache, order_cache);
+    for (unsigned int i = 0; i < chunks.size(); ++i) {
+        chunks[i].id = i;
+    }
+
+    // skip chunks committed by an earlier run
+    Journal journal;
+    if (options.journal != "") {
+        string error;
+        unsigned long long fingerprint = plan_fingerprint(volume, chunks,
+                options.label_name, options.block_size, options.compress, condition, roi_ptr);
+        if (!journal.open(options.journal, fingerprint, options.resume, error)) {
+            cout << "Error: journal: " << options.journal << ": " << error << endl;
+            exit(1);
+        }
+        if (options.resume) {
+            vector<Chunk> remaining;
+            for (unsigned int i = 0; i < chunks.size(); ++i) {
+                if (!journal.is_committed(chunks[i].id)) {
+                    remaining.push_back(chunks[i]);
                 }
             }
+            cout << "Resuming: " << chunks.size() - remaining.size() << " of "
+                << chunks.size() << " chunks already committed" << endl;
+            chunks.swap(remaining);
         }
+    }
+    Journal* journal_ptr = (options.journal != "") ? &journal : 0;
 
-        // write new volume back
-        libdvid::Labels3D labelbin = libdvid::Labels3D(ldata_raw,
-                sizeof(unsigned long long)*(width)*(maxy-miny+1), sizes);
-        
-        dvid_node.put_labels3D(label_name, labelbin, start, false);
+    // load each subvolume, relabel sparsely, and write back
+    ChunkLoader loader(options.label_name, options.block_size, options.compress,
+            condition, snapshot_ptr);
+    try {
+        boost::shared_ptr<ChunkPipeline> pipeline;
+        if (options.threads > 1) {
+            pipeline = boost::shared_ptr<ChunkPipeline>(new ChunkPipeline(
+                        options.dvid_servername, options.uuid, loader,
+                        options.threads, options.inflight, journal_ptr));
+        }
+        load_chunks(loader, dvid_node, pipeline.get(), volume, chunks, journal_ptr, stats);
+        if (journal_ptr) {
+            journal_ptr->flush();
+        }
+    } catch (std::exception& e) {
+        cout << "Error: load failed: " << e.what() << endl;
+        finish_snapshot(snapshot_ptr, options.undo);
+        exit(1);
     }
+    finish_snapshot(snapshot_ptr, options.undo);
+
+    cout << "Loaded " << volume.num_planes() << " planes in " << chunks.size()
+        << " chunks" << endl;
+    stats.print(cout);
 
     return 0;
 }
-
-
-
@@ -0,0 +1,181 @@
+/*!
+ * Microbenchmark comparing the span fill kernel used by
+ * dvid_load_sparse with the original voxel-at-a-time loop.  Span
+ * lengths are drawn from geometric distributions resembling thin
+ * axons, dendrites, and cell bodies, and from a mix of the three.
+*/
+
+#include "FillKernel.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <time.h>
+
+using std::cout; using std::endl;
+using std::vector;
+
+using namespace DVIDLoadSparse;
+
+static const int WIDTH = 4096;
+static const int HEIGHT = 1024;
+static const int REPEATS = 5;
+
+struct Span {
+    size_t offset;
+    int length;
+};
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// geometric span length with the given mean (at least 1)
+static int span_length(double mean)
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    int length = 1 + (int) (std::log(u) / std::log(1.0 - 1.0 / mean));
+    return (length < WIDTH) ? length : WIDTH;
+}
+
+// spans packed left to right in each row with random gaps
+static void make_spans(const vector<double>& means, vector<Span>& spans,
+        unsigned long long& voxels)
+{
+    spans.clear();
+    voxels = 0;
+    for (int y = 0; y < HEIGHT; ++y) {
+        int x = rand() % 16;
+        while (true) {
+            int length = span_length(means[rand() % means.size()]);
+            if (x + length > WIDTH) {
+                break;
+            }
+            Span span;
+            span.offset = (size_t) y * WIDTH + x;
+            span.length = length;
+            spans.push_back(span);
+            voxels += length;
+            x += length + 1 + rand() % 32;
+        }
+    }
+}
+
+// loop from the original loader
+static void fill_scalar(unsigned long long* ldata, const vector<Span>& spans,
+        unsigned long long label)
+{
+    for (unsigned int i = 0; i < spans.size(); ++i) {
+        for (int j = 0; j < spans[i].length; ++j) {
+            ldata[spans[i].offset + j] = label;
+        }
+    }
+}
+
+static void fill_kernel(unsigned long long* ldata, const vector<Span>& spans,
+        unsigned long long label)
+{
+    for (unsigned int i = 0; i < spans.size(); ++i) {
+        fill_labels(ldata + spans[i].offset, spans[i].length, label);
+    }
+}
+
+/*!
+ * Check that the kernels leave the same labels as the scalar loops.
+ * Buffers start with a pattern so writes outside the spans show up.
+*/
+static bool kernels_match(const vector<Span>& spans)
+{
+    vector<unsigned long long> expected((size_t) WIDTH * HEIGHT);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        expected[i] = i % 3;
+    }
+    vector<unsigned long long> actual(expected);
+
+    fill_scalar(&expected[0], spans, 7);
+    fill_kernel(&actual[0], spans, 7);
+    if (expected != actual) {
+        return false;
+    }
+
+    // conditional overwrite of labels 7 and 2 (the gaps still hold 0 to 2)
+    size_t expected_changed = 0, actual_changed = 0;
+    for (unsigned int i = 0; i < spans.size(); ++i) {
+        for (int j = 0; j < spans[i].length; ++j) {
+            expected_changed += replace_label(expected[spans[i].offset + j], 7, 2, 9);
+        }
+        actual_changed += replace_labels(&actual[spans[i].offset], spans[i].length, 7, 2, 9);
+    }
+    return (expected == actual) && (expected_changed == actual_changed);
+}
+
+static double best_time(void (*fill)(unsigned long long*, const vector<Span>&,
+            unsigned long long), vector<unsigned long long>& ldata,
+        const vector<Span>& spans)
+{
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; ++r) {
+        double start = now_seconds();
+        fill(&ldata[0], spans, r + 1);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main()
+{
+    srand(12345);
+    vector<unsigned long long> ldata((size_t) WIDTH * HEIGHT, 0);
+
+    const char* names[] = { "axon (mean 8)", "dendrite (mean 60)",
+        "soma (mean 800)", "mixed" };
+    vector<vector<double> > distributions(4);
+    distributions[0].push_back(8);
+    distributions[1].push_back(60);
+    distributions[2].push_back(800);
+    distributions[3].push_back(8);
+    distributions[3].push_back(8);
+    distributions[3].push_back(60);
+    distributions[3].push_back(800);
+
+#if defined(__AVX2__)
+    cout << "Fill kernel: AVX2" << endl;
+#elif defined(__SSE2__)
+    cout << "Fill kernel: SSE2" << endl;
+#else
+    cout << "Fill kernel: scalar" << endl;
+#endif
+    cout << std::left << std::setw(22) << "distribution" << std::setw(12) << "spans"
+        << std::setw(16) << "scalar ns/vox" << std::setw(16) << "kernel ns/vox"
+        << "speedup" << endl;
+
+    unsigned long long checksum = 0;
+    bool mismatch = false;
+    for (unsigned int d = 0; d < distributions.size(); ++d) {
+        vector<Span> spans;
+        unsigned long long voxels;
+        make_spans(distributions[d], spans, voxels);
+        if (!kernels_match(spans)) {
+            cout << "Error: kernel and scalar labels differ for " << names[d] << endl;
+            mismatch = true;
+        }
+
+        double scalar = best_time(fill_scalar, ldata, spans);
+        double kernel = best_time(fill_kernel, ldata, spans);
+        checksum += ldata[spans[spans.size() / 2].offset];
+
+        cout << std::left << std::setw(22) << names[d] << std::setw(12) << spans.size()
+            << std::setw(16) << scalar * 1e9 / voxels << std::setw(16)
+            << kernel * 1e9 / voxels << scalar / kernel << endl;
+    }
+    // the checksum keeps the timed fills observable
+    return (mismatch || checksum == 0) ? 1 : 0;
+}
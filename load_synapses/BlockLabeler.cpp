@@ -0,0 +1,64 @@
+#include "BlockLabeler.h"
+
+using std::vector;
+
+namespace DVIDLoadSynapses {
+
+// true if both points lie in the same lookup block
+static bool same_block(const SynapsePoint& a, const SynapsePoint& b, unsigned int lookup_size)
+{
+    return (a.x / lookup_size == b.x / lookup_size) &&
+        (a.y / lookup_size == b.y / lookup_size) &&
+        (a.z / lookup_size == b.z / lookup_size);
+}
+
+void BlockLabeler::label_points(const vector<SynapsePoint>& points,
+        vector<unsigned long long>& labels, LookupStats& stats)
+{
+    labels.assign(points.size(), 0);
+
+    libdvid::Dims_t sizes;
+    sizes.push_back(lookup_size); sizes.push_back(lookup_size);
+    sizes.push_back(lookup_size);
+    unsigned long long block_voxels = (unsigned long long) lookup_size *
+        lookup_size * lookup_size;
+
+    // points arrive grouped by block (see SortedLabeler), so each
+    // run of consecutive points in one block is fetched once
+    size_t pos = 0;
+    while (pos < points.size()) {
+        size_t end = pos + 1;
+        while ((end < points.size()) && same_block(points[end], points[pos], lookup_size)) {
+            ++end;
+        }
+
+        vector<unsigned int> start;
+        start.push_back(points[pos].x / lookup_size * lookup_size);
+        start.push_back(points[pos].y / lookup_size * lookup_size);
+        start.push_back(points[pos].z / lookup_size * lookup_size);
+
+        libdvid::Labels3D block = dvid_node.get_labels3D(label_name,
+                sizes, start, compress);
+        const unsigned long long* block_labels =
+            (const unsigned long long*) block.get_raw();
+
+        ++stats.requests;
+        ++stats.blocks;
+        stats.label_bytes += block_voxels * sizeof(unsigned long long);
+        stats.wire.add((const char*) block_labels,
+                block_voxels * sizeof(unsigned long long), compress);
+
+        // resolve every point of the block locally
+        for (size_t i = pos; i < end; ++i) {
+            const SynapsePoint& point = points[i];
+            size_t offset = ((size_t)(point.z - start[2]) * lookup_size +
+                    (point.y - start[1])) * lookup_size + (point.x - start[0]);
+            labels[i] = block_labels[offset];
+        }
+        stats.points += end - pos;
+
+        pos = end;
+    }
+}
+
+}
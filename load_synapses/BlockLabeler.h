@@ -0,0 +1,52 @@
+/*!
+ * Resolves the labels of many points by fetching the lookup block
+ * around each run of points in it instead of issuing one request
+ * per point.
+*/
+
+#ifndef BLOCKLABELER_H
+#define BLOCKLABELER_H
+
+#include "Labeler.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class BlockLabeler : public Labeler {
+  public:
+    /*!
+     * \param dvid_node connection used for all requests
+     * \param label_name name of the label volume
+     * \param lookup_size edge of the aligned cube fetched per request
+     * (1 fetches every distinct point on its own)
+     * \param compress transfer labels lz4 compressed
+    */
+    BlockLabeler(libdvid::DVIDNodeService& dvid_node, std::string label_name,
+            unsigned int lookup_size, bool compress) : dvid_node(dvid_node),
+        label_name(label_name), lookup_size(lookup_size), compress(compress) {}
+
+    /*!
+     * Find the label under each point.  Consecutive points in the
+     * same lookup block are resolved with one fetch of that block,
+     * so callers should pass points grouped by block (SortedLabeler
+     * sends them in Morton order); the order is kept as given.
+     * \param points locations to resolve
+     * \param labels label of points[i] is written to labels[i]
+     * \param stats request and byte counters are added here
+    */
+    void label_points(const std::vector<SynapsePoint>& points,
+            std::vector<unsigned long long>& labels, LookupStats& stats);
+
+  private:
+    libdvid::DVIDNodeService& dvid_node;
+    std::string label_name;
+    unsigned int lookup_size;
+    bool compress;
+};
+
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*!
+ * Common interface of the point label lookup backends.
+*/
+
+#ifndef LABELER_H
+#define LABELER_H
+
+#include "SynapseSet.h"
+#include "LookupStats.h"
+
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class Labeler {
+  public:
+    virtual ~Labeler() {}
+
+    /*!
+     * Find the label under each point.  Throws std::runtime_error
+     * if the server response cannot be used.
+     * \param points locations to resolve
+     * \param labels label of points[i] is written to labels[i]
+     * \param stats request and byte counters are added here
+    */
+    virtual void label_points(const std::vector<SynapsePoint>& points,
+            std::vector<unsigned long long>& labels, LookupStats& stats) = 0;
+};
+
+}
+
+#endif
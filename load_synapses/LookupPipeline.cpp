@@ -0,0 +1,163 @@
+#include "LookupPipeline.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <stdexcept>
+
+using std::vector;
+using std::string;
+
+namespace DVIDLoadSynapses {
+
+LookupPipeline::LookupPipeline(const vector<boost::shared_ptr<Labeler> >& labelers,
+        int max_inflight) : labelers(labelers), max_inflight(max_inflight),
+    num_read(0), next_seq(0), inflight(0), reading_done(false), failed(false)
+{
+}
+
+void LookupPipeline::run(SynapseReader& reader, size_t read_batch,
+        BatchHandler handler, LookupStats& stats_)
+{
+    labeled.clear();
+    num_read = 0;
+    next_seq = 0;
+    inflight = 0;
+    reading_done = false;
+    failed = false;
+    stats = LookupStats();
+    lookup_queue.reopen();
+
+    boost::thread_group lookup_threads;
+    for (size_t i = 0; i < labelers.size(); ++i) {
+        lookup_threads.create_thread(boost::bind(&LookupPipeline::lookup_worker,
+                    this, labelers[i].get()));
+    }
+    boost::thread aggregate_thread(boost::bind(&LookupPipeline::aggregate_worker,
+                this, handler));
+
+    // read batches as memory allows
+    while (!reader.done()) {
+        {
+            boost::mutex::scoped_lock lock(state_mutex);
+            while (!failed && (inflight >= max_inflight)) {
+                state_changed.wait(lock);
+            }
+            if (failed) {
+                break;
+            }
+        }
+
+        Batch batch;
+        batch.synapses = boost::shared_ptr<SynapseSet>(new SynapseSet);
+        batch.labels = boost::shared_ptr<vector<unsigned long long> >(
+                new vector<unsigned long long>);
+        string error;
+        if (!reader.read_batch(read_batch, *batch.synapses, error)) {
+            fail("input file: " + reader.get_filename() + " " + error);
+            break;
+        }
+        if (batch.synapses->num_synapses() == 0) {
+            continue;
+        }
+
+        {
+            boost::mutex::scoped_lock lock(state_mutex);
+            batch.seq = num_read++;
+            ++inflight;
+            stats.synapses += batch.synapses->num_synapses();
+            ++stats.batches;
+        }
+        lookup_queue.push(batch);
+    }
+
+    lookup_queue.close();
+    lookup_threads.join_all();
+    {
+        boost::mutex::scoped_lock lock(state_mutex);
+        reading_done = true;
+        state_changed.notify_all();
+    }
+    aggregate_thread.join();
+
+    if (failed) {
+        throw std::runtime_error(error_msg);
+    }
+    stats_.merge(stats);
+}
+
+void LookupPipeline::lookup_worker(Labeler* labeler)
+{
+    LookupStats worker_stats;
+    Batch batch;
+    while (lookup_queue.pop(batch)) {
+        if (has_failed()) {
+            continue;
+        }
+        try {
+            labeler->label_points(batch.synapses->get_points(), *batch.labels,
+                    worker_stats);
+        } catch (std::exception& e) {
+            fail(string("label lookup failed: ") + e.what());
+            continue;
+        }
+
+        boost::mutex::scoped_lock lock(state_mutex);
+        labeled[batch.seq] = batch;
+        state_changed.notify_all();
+    }
+
+    boost::mutex::scoped_lock lock(state_mutex);
+    stats.merge(worker_stats);
+}
+
+void LookupPipeline::aggregate_worker(BatchHandler handler)
+{
+    while (true) {
+        Batch batch;
+        {
+            // batches are aggregated strictly in the order they were read
+            boost::mutex::scoped_lock lock(state_mutex);
+            while (!failed && (labeled.find(next_seq) == labeled.end()) &&
+                    !(reading_done && (next_seq == num_read))) {
+                state_changed.wait(lock);
+            }
+            if (failed || (labeled.find(next_seq) == labeled.end())) {
+                return;
+            }
+            batch = labeled[next_seq];
+            labeled.erase(next_seq);
+        }
+
+        try {
+            handler(*batch.synapses, *batch.labels);
+        } catch (std::exception& e) {
+            fail(e.what());
+            return;
+        }
+
+        // release the batch before another one can be read
+        batch = Batch();
+        boost::mutex::scoped_lock lock(state_mutex);
+        ++next_seq;
+        --inflight;
+        state_changed.notify_all();
+    }
+}
+
+void LookupPipeline::fail(string msg)
+{
+    boost::mutex::scoped_lock lock(state_mutex);
+    if (!failed) {
+        failed = true;
+        error_msg = msg;
+    }
+    state_changed.notify_all();
+}
+
+bool LookupPipeline::has_failed()
+{
+    boost::mutex::scoped_lock lock(state_mutex);
+    return failed;
+}
+
+}
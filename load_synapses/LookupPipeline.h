@@ -0,0 +1,84 @@
+/*!
+ * Multi-threaded label lookup.  The main thread reads batches of
+ * synapses, a pool of workers resolves their labels concurrently,
+ * and a single aggregator hands the labeled batches to the caller
+ * in file order, so the result does not depend on the number of
+ * workers or on which batch finishes first.  At most max_inflight
+ * batches are held in memory.
+*/
+
+#ifndef LOOKUPPIPELINE_H
+#define LOOKUPPIPELINE_H
+
+#include "Labeler.h"
+#include "SynapseReader.h"
+#include "WorkQueue.h"
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class LookupPipeline {
+  public:
+    //! called with each batch and the labels of its points
+    typedef boost::function<void (const SynapseSet&,
+            const std::vector<unsigned long long>&)> BatchHandler;
+
+    /*!
+     * \param labelers one labeler (with its own connections) per worker
+     * \param max_inflight maximum batches read but not yet aggregated
+    */
+    LookupPipeline(const std::vector<boost::shared_ptr<Labeler> >& labelers,
+            int max_inflight);
+
+    /*!
+     * Read the rest of the synapse file and pass every labeled batch
+     * to handler, in file order, from a single thread.  Throws
+     * std::runtime_error with the first read or lookup error.
+     * \param reader opened synapse file
+     * \param read_batch points per batch
+     * \param handler consumes labeled batches
+     * \param stats lookup counters are added here
+    */
+    void run(SynapseReader& reader, size_t read_batch, BatchHandler handler,
+            LookupStats& stats);
+
+  private:
+    struct Batch {
+        size_t seq;
+        boost::shared_ptr<SynapseSet> synapses;
+        boost::shared_ptr<std::vector<unsigned long long> > labels;
+    };
+
+    void lookup_worker(Labeler* labeler);
+    void aggregate_worker(BatchHandler handler);
+    void fail(std::string msg);
+    bool has_failed();
+
+    std::vector<boost::shared_ptr<Labeler> > labelers;
+    int max_inflight;
+
+    DVIDUtils::WorkQueue<Batch> lookup_queue;
+
+    // state protected by state_mutex
+    std::map<size_t, Batch> labeled;
+    size_t num_read;
+    size_t next_seq;
+    int inflight;
+    bool reading_done;
+    bool failed;
+    std::string error_msg;
+    LookupStats stats;
+    boost::mutex state_mutex;
+    boost::condition_variable state_changed;
+};
+
+}
+
+#endif
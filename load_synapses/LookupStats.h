@@ -0,0 +1,85 @@
+/*!
+ * Request and transfer counters for point label lookups.
+*/
+
+#ifndef LOOKUPSTATS_H
+#define LOOKUPSTATS_H
+
+#include "WireBytes.h"
+
+#include <ostream>
+
+namespace DVIDLoadSynapses {
+
+struct LookupStats {
+    LookupStats() : synapses(0), batches(0), synapse_points(0), file_block_runs(0),
+        sorted_block_runs(0), points(0), requests(0), blocks(0), label_bytes(0) {}
+
+    //! synapses read and batches they were read in
+    unsigned long long synapses;
+    unsigned long long batches;
+
+    //! T-bar and PSD locations read (before removing duplicates)
+    unsigned long long synapse_points;
+    //! runs of consecutive points in one block, in file and in lookup order
+    unsigned long long file_block_runs;
+    unsigned long long sorted_block_runs;
+
+    //! points whose label was resolved
+    unsigned long long points;
+    //! http requests issued to DVID
+    unsigned long long requests;
+    //! distinct lookup blocks fetched
+    unsigned long long blocks;
+    //! label bytes requested
+    unsigned long long label_bytes;
+    //! bytes actually transferred (estimated when compressed)
+    DVIDUtils::WireBytes wire;
+
+    //! accumulate counters from another batch or thread
+    void merge(const LookupStats& other)
+    {
+        synapses += other.synapses;
+        batches += other.batches;
+        synapse_points += other.synapse_points;
+        file_block_runs += other.file_block_runs;
+        sorted_block_runs += other.sorted_block_runs;
+        points += other.points;
+        requests += other.requests;
+        blocks += other.blocks;
+        label_bytes += other.label_bytes;
+        wire.merge(other.wire);
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "Read " << synapses << " synapses in " << batches << " batches" << std::endl;
+        if (synapse_points) {
+            os << "Distinct points: " << points << " of " << synapse_points
+                << " (dedup ratio: " << double(synapse_points) / (points ? points : 1)
+                << ")" << std::endl;
+            os << "Block runs: " << file_block_runs << " in file order, "
+                << sorted_block_runs << " in Morton order";
+            if (sorted_block_runs) {
+                os << " (" << double(file_block_runs) / sorted_block_runs
+                    << "x fewer block switches)";
+            }
+            os << std::endl;
+        }
+        os << "Looked up " << points << " points with " << requests << " requests";
+        if (requests) {
+            os << " (" << double(points) / requests << " points per request)";
+        }
+        os << std::endl;
+        if (blocks) {
+            os << "Lookup blocks fetched: " << blocks << std::endl;
+        }
+        os << "Label bytes: " << label_bytes << " (on wire: ";
+        wire.print(os);
+        os << ")" << std::endl;
+    }
+};
+
+}
+
+#endif
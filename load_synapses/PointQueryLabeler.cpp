@@ -0,0 +1,123 @@
+#include "PointQueryLabeler.h"
+
+#include <json/json.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using std::vector;
+using std::string;
+
+namespace DVIDLoadSynapses {
+
+PointQueryLabeler::PointQueryLabeler(string server, string uuid, string label_name,
+        unsigned int batch_size, int num_inflight) :
+    endpoint("/" + label_name + "/labels"), batch_size(batch_size),
+    points(0), labels(0), next_batch(0), failed(false)
+{
+    // connections are created up front on the main thread
+    for (int i = 0; i < num_inflight; ++i) {
+        dvid_nodes.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                    new libdvid::DVIDNodeService(server, uuid)));
+    }
+}
+
+void PointQueryLabeler::label_points(const vector<SynapsePoint>& points_,
+        vector<unsigned long long>& labels_, LookupStats& stats_)
+{
+    labels_.assign(points_.size(), 0);
+    points = &points_;
+    labels = &labels_;
+    next_batch = 0;
+    stats = LookupStats();
+    failed = false;
+
+    // every worker pulls the next unsent batch until none are left
+    boost::thread_group query_threads;
+    for (size_t i = 0; i < dvid_nodes.size(); ++i) {
+        query_threads.create_thread(boost::bind(&PointQueryLabeler::query_worker,
+                    this, dvid_nodes[i].get()));
+    }
+    query_threads.join_all();
+
+    if (failed) {
+        throw std::runtime_error(error_msg);
+    }
+    stats_.merge(stats);
+}
+
+void PointQueryLabeler::query_worker(libdvid::DVIDNodeService* dvid_node)
+{
+    LookupStats worker_stats;
+    while (true) {
+        size_t begin;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            begin = next_batch * batch_size;
+            if (failed || begin >= points->size()) {
+                break;
+            }
+            ++next_batch;
+        }
+        size_t end = std::min(begin + batch_size, points->size());
+
+        try {
+            query_batch(*dvid_node, begin, end, worker_stats);
+        } catch (std::exception& e) {
+            boost::mutex::scoped_lock lock(mutex);
+            if (!failed) {
+                failed = true;
+                error_msg = e.what();
+            }
+        }
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    stats.merge(worker_stats);
+}
+
+void PointQueryLabeler::query_batch(libdvid::DVIDNodeService& dvid_node,
+        size_t begin, size_t end, LookupStats& worker_stats)
+{
+    // body is a json list of [x,y,z] coordinates
+    std::ostringstream sstr;
+    sstr << "[";
+    for (size_t i = begin; i < end; ++i) {
+        const SynapsePoint& point = (*points)[i];
+        sstr << ((i == begin) ? "" : ",") << "[" << point.x << "," << point.y
+            << "," << point.z << "]";
+    }
+    sstr << "]";
+    string body = sstr.str();
+
+    libdvid::BinaryDataPtr payload = libdvid::BinaryData::create_binary_data(
+            body.c_str(), body.size());
+    libdvid::BinaryDataPtr response = dvid_node.custom_request(endpoint, payload,
+            libdvid::GET);
+
+    // response is a json list with one label per coordinate
+    Json::Reader json_reader;
+    Json::Value json_labels;
+    const char* response_data = (const char*) response->get_raw();
+    if (!json_reader.parse(response_data, response_data + response->length(),
+                json_labels) || !json_labels.isArray() ||
+            (json_labels.size() != (end - begin))) {
+        std::ostringstream msg;
+        msg << "labels query for points " << begin << "-" << (end - 1)
+            << " returned an unexpected response";
+        throw std::runtime_error(msg.str());
+    }
+    for (size_t i = begin; i < end; ++i) {
+        (*labels)[i] = json_labels[(unsigned int)(i - begin)].asUInt64();
+    }
+
+    ++worker_stats.requests;
+    worker_stats.points += end - begin;
+    worker_stats.label_bytes += (end - begin) * sizeof(unsigned long long);
+    worker_stats.wire.add(body.c_str(), body.size(), false);
+    worker_stats.wire.add((const char*) response->get_raw(), response->length(), false);
+}
+
+}
@@ -0,0 +1,65 @@
+/*!
+ * Resolves point labels with DVID's labels-at-points query: the
+ * coordinates are posted in batches and the server returns the
+ * label of each one.  Several batches are kept in flight at once.
+*/
+
+#ifndef POINTQUERYLABELER_H
+#define POINTQUERYLABELER_H
+
+#include "Labeler.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class PointQueryLabeler : public Labeler {
+  public:
+    /*!
+     * Create one DVID connection per concurrent batch.
+     * \param server dvid server name
+     * \param uuid dvid node uuid
+     * \param label_name name of the label volume
+     * \param batch_size maximum points per request
+     * \param num_inflight number of requests issued concurrently
+    */
+    PointQueryLabeler(std::string server, std::string uuid, std::string label_name,
+            unsigned int batch_size, int num_inflight);
+
+    /*!
+     * Find the label under each point.  Points are sent in the
+     * order given (Morton order of their blocks when called through
+     * SortedLabeler), batch_size at a time.
+     * \param points locations to resolve
+     * \param labels label of points[i] is written to labels[i]
+     * \param stats request and byte counters are added here
+    */
+    void label_points(const std::vector<SynapsePoint>& points,
+            std::vector<unsigned long long>& labels, LookupStats& stats);
+
+  private:
+    void query_worker(libdvid::DVIDNodeService* dvid_node);
+    void query_batch(libdvid::DVIDNodeService& dvid_node, size_t begin, size_t end,
+            LookupStats& worker_stats);
+
+    std::string endpoint;
+    unsigned int batch_size;
+    std::vector<boost::shared_ptr<libdvid::DVIDNodeService> > dvid_nodes;
+
+    // state of the current label_points call
+    const std::vector<SynapsePoint>* points;
+    std::vector<unsigned long long>* labels;
+    size_t next_batch;
+    LookupStats stats;
+    bool failed;
+    std::string error_msg;
+    boost::mutex mutex;
+};
+
+}
+
+#endif
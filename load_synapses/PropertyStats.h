@@ -0,0 +1,61 @@
+/*!
+ * Counters for vertex property writes.
+*/
+
+#ifndef PROPERTYSTATS_H
+#define PROPERTYSTATS_H
+
+#include <ostream>
+
+namespace DVIDLoadSynapses {
+
+struct PropertyStats {
+    PropertyStats() : vertices(0), written(0), unchanged(0), batches(0),
+        requests(0), retries(0), bytes(0), seconds(0) {}
+
+    //! vertices handled, written and left alone since nothing changed
+    unsigned long long vertices;
+    unsigned long long written;
+    unsigned long long unchanged;
+    //! vertex batches and http requests (property reads and writes)
+    unsigned long long batches;
+    unsigned long long requests;
+    //! vertices sent again after a transaction conflict
+    unsigned long long retries;
+    //! property bytes written
+    unsigned long long bytes;
+    //! wall time spent writing
+    double seconds;
+
+    void merge(const PropertyStats& other)
+    {
+        vertices += other.vertices;
+        written += other.written;
+        unchanged += other.unchanged;
+        batches += other.batches;
+        requests += other.requests;
+        retries += other.retries;
+        bytes += other.bytes;
+        seconds += other.seconds;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "Wrote " << written << " vertex properties in " << batches
+            << " batches (" << requests << " requests, " << retries
+            << " retried after conflicts)" << std::endl;
+        if (unchanged) {
+            os << "Unchanged vertices skipped: " << unchanged << std::endl;
+        }
+        os << "Property bytes: " << bytes;
+        if (seconds > 0) {
+            os << " in " << seconds << " s (" << written / seconds << " vertices/s, "
+                << bytes / seconds / (1 << 20) << " MB/s)";
+        }
+        os << std::endl;
+    }
+};
+
+}
+
+#endif
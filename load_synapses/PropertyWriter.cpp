@@ -0,0 +1,189 @@
+#include "PropertyWriter.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <tr1/unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <time.h>
+
+using std::vector;
+using std::string;
+using std::cout; using std::endl;
+
+namespace DVIDLoadSynapses {
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+PropertyWriter::PropertyWriter(string server, string uuid, string graph_name,
+        string key, unsigned int batch_size, int num_inflight, int max_retries) :
+    graph_name(graph_name), key(key), batch_size(batch_size),
+    max_retries(max_retries), vertex_ids(0), next_batch(0), vertices_done(0),
+    last_decile(0), start_time(0), failed(false)
+{
+    // connections are created up front on the main thread
+    for (int i = 0; i < num_inflight; ++i) {
+        dvid_nodes.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                    new libdvid::DVIDNodeService(server, uuid)));
+    }
+}
+
+void PropertyWriter::write(const vector<unsigned long long>& vertex_ids_,
+        UpdateFunction update_, PropertyStats& stats_)
+{
+    vertex_ids = &vertex_ids_;
+    update = update_;
+    next_batch = 0;
+    vertices_done = 0;
+    last_decile = 0;
+    stats = PropertyStats();
+    failed = false;
+    start_time = now_seconds();
+
+    // every worker pulls the next unwritten batch until none are left
+    boost::thread_group write_threads;
+    for (size_t i = 0; i < dvid_nodes.size(); ++i) {
+        write_threads.create_thread(boost::bind(&PropertyWriter::write_worker,
+                    this, dvid_nodes[i].get()));
+    }
+    write_threads.join_all();
+
+    stats.seconds = now_seconds() - start_time;
+    stats_.merge(stats);
+    if (failed) {
+        throw std::runtime_error(error_msg);
+    }
+}
+
+void PropertyWriter::write_worker(libdvid::DVIDNodeService* dvid_node)
+{
+    PropertyStats worker_stats;
+    while (true) {
+        size_t begin;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            begin = next_batch * batch_size;
+            if (failed || begin >= vertex_ids->size()) {
+                break;
+            }
+            ++next_batch;
+        }
+        size_t end = std::min(begin + batch_size, vertex_ids->size());
+
+        try {
+            write_batch(*dvid_node, begin, end, worker_stats);
+        } catch (std::exception& e) {
+            boost::mutex::scoped_lock lock(mutex);
+            if (!failed) {
+                failed = true;
+                error_msg = e.what();
+            }
+        }
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    stats.merge(worker_stats);
+}
+
+void PropertyWriter::write_batch(libdvid::DVIDNodeService& dvid_node, size_t begin,
+        size_t end, PropertyStats& worker_stats)
+{
+    // vertices still to be written, by position in vertex_ids
+    vector<size_t> pending;
+    std::tr1::unordered_map<unsigned long long, size_t> positions;
+    for (size_t i = begin; i < end; ++i) {
+        pending.push_back(i);
+        positions[(*vertex_ids)[i]] = i;
+    }
+    ++worker_stats.batches;
+    worker_stats.vertices += end - begin;
+
+    for (int attempt = 0; !pending.empty(); ++attempt) {
+        if (attempt > max_retries) {
+            std::ostringstream sstr;
+            sstr << pending.size() << " vertices still conflict after "
+                << max_retries << " retries (first: " << (*vertex_ids)[pending[0]] << ")";
+            throw std::runtime_error(sstr.str());
+        }
+        if (attempt > 0) {
+            worker_stats.retries += pending.size();
+        }
+
+        // read current values and fresh transaction ids
+        vector<libdvid::Vertex> vertices;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            vertices.push_back(libdvid::Vertex((*vertex_ids)[pending[i]], 0));
+        }
+        vector<libdvid::BinaryDataPtr> current;
+        libdvid::VertexTransactions transaction_ids;
+        dvid_node.get_properties(graph_name, vertices, key, current, transaction_ids);
+        ++worker_stats.requests;
+        if (current.size() != vertices.size()) {
+            throw std::runtime_error("property read returned the wrong number of vertices");
+        }
+
+        vector<libdvid::Vertex> changed;
+        vector<libdvid::BinaryDataPtr> properties;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            libdvid::BinaryDataPtr property = update(pending[i], current[i]);
+            if (property) {
+                changed.push_back(vertices[i]);
+                properties.push_back(property);
+            } else if (attempt == 0) {
+                ++worker_stats.unchanged;
+            }
+        }
+        if (changed.empty()) {
+            break;
+        }
+
+        vector<libdvid::Vertex> leftover_vertices;
+        dvid_node.set_properties(graph_name, changed, key, properties,
+                transaction_ids, leftover_vertices);
+        ++worker_stats.requests;
+
+        // leftovers were modified by someone else since the read
+        std::tr1::unordered_map<unsigned long long, bool> leftover;
+        for (size_t i = 0; i < leftover_vertices.size(); ++i) {
+            leftover[leftover_vertices[i].id] = true;
+        }
+        pending.clear();
+        for (size_t i = 0; i < changed.size(); ++i) {
+            if (leftover.find(changed[i].id) != leftover.end()) {
+                pending.push_back(positions[changed[i].id]);
+            } else {
+                ++worker_stats.written;
+                worker_stats.bytes += properties[i]->length();
+            }
+        }
+    }
+
+    report_progress(end - begin);
+}
+
+void PropertyWriter::report_progress(size_t vertices)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    vertices_done += vertices;
+    int decile = (int) (vertices_done * 10 / vertex_ids->size());
+    if (decile > last_decile) {
+        last_decile = decile;
+        double elapsed = now_seconds() - start_time;
+        cout << "Wrote properties of " << vertices_done << " / " << vertex_ids->size()
+            << " vertices";
+        if (elapsed > 0) {
+            cout << " (" << (unsigned long long) (vertices_done / elapsed)
+                << " vertices/s)";
+        }
+        cout << endl;
+    }
+}
+
+}
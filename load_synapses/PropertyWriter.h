@@ -0,0 +1,88 @@
+/*!
+ * Writes vertex properties of a labelgraph in bounded batches.
+ * Each batch reads the current properties (which also returns the
+ * vertex transaction ids), computes the new values and writes them
+ * under transaction protection.  Vertices whose transaction went
+ * stale in the meantime come back as leftovers and are retried with
+ * freshly read transaction ids.  Several batches are in flight at
+ * once, each on its own connection.
+*/
+
+#ifndef PROPERTYWRITER_H
+#define PROPERTYWRITER_H
+
+#include "PropertyStats.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class PropertyWriter {
+  public:
+    /*!
+     * Computes the property of vertex i from its current value (an
+     * empty buffer if it has none).  Returns a null pointer to leave
+     * the vertex unchanged.  Must be thread-safe.
+    */
+    typedef boost::function<libdvid::BinaryDataPtr (size_t,
+            libdvid::BinaryDataPtr)> UpdateFunction;
+
+    /*!
+     * Create one DVID connection per concurrent batch.
+     * \param server dvid server name
+     * \param uuid dvid node uuid
+     * \param graph_name name of the labelgraph
+     * \param key property key
+     * \param batch_size maximum vertices per request
+     * \param num_inflight batches written concurrently
+     * \param max_retries times a conflicting vertex is retried
+    */
+    PropertyWriter(std::string server, std::string uuid, std::string graph_name,
+            std::string key, unsigned int batch_size, int num_inflight,
+            int max_retries);
+
+    /*!
+     * Update the property of every vertex.  Progress is reported on
+     * standard output.  Throws std::runtime_error if a vertex still
+     * conflicts after max_retries attempts; batches already written
+     * stay written.
+     * \param vertex_ids vertices to update
+     * \param update computes the new property of vertex_ids[i]
+     * \param stats write counters are added here
+    */
+    void write(const std::vector<unsigned long long>& vertex_ids,
+            UpdateFunction update, PropertyStats& stats);
+
+  private:
+    void write_worker(libdvid::DVIDNodeService* dvid_node);
+    void write_batch(libdvid::DVIDNodeService& dvid_node, size_t begin, size_t end,
+            PropertyStats& worker_stats);
+    void report_progress(size_t vertices);
+
+    std::string graph_name;
+    std::string key;
+    unsigned int batch_size;
+    int max_retries;
+    std::vector<boost::shared_ptr<libdvid::DVIDNodeService> > dvid_nodes;
+
+    // state of the current write call
+    const std::vector<unsigned long long>* vertex_ids;
+    UpdateFunction update;
+    size_t next_batch;
+    size_t vertices_done;
+    int last_decile;
+    double start_time;
+    PropertyStats stats;
+    bool failed;
+    std::string error_msg;
+    boost::mutex mutex;
+};
+
+}
+
+#endif
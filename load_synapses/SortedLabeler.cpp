@@ -0,0 +1,93 @@
+#include "SortedLabeler.h"
+#include "MortonCode.h"
+
+#include <algorithm>
+
+using std::vector;
+
+namespace DVIDLoadSynapses {
+
+// point index ordered by block Morton code, then by position
+struct SortKey {
+    unsigned long long code;
+    unsigned int z, y, x;
+    size_t index;
+
+    bool operator<(const SortKey& other) const
+    {
+        if (code != other.code) {
+            return code < other.code;
+        }
+        if (z != other.z) {
+            return z < other.z;
+        }
+        if (y != other.y) {
+            return y < other.y;
+        }
+        if (x != other.x) {
+            return x < other.x;
+        }
+        return index < other.index;
+    }
+
+    bool same_point(const SortKey& other) const
+    {
+        return (x == other.x) && (y == other.y) && (z == other.z);
+    }
+};
+
+// number of runs of consecutive points in the same block
+static unsigned long long block_runs(const vector<SynapsePoint>& points,
+        unsigned int block_size)
+{
+    unsigned long long runs = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if ((i == 0) || (points[i].x / block_size != points[i-1].x / block_size) ||
+                (points[i].y / block_size != points[i-1].y / block_size) ||
+                (points[i].z / block_size != points[i-1].z / block_size)) {
+            ++runs;
+        }
+    }
+    return runs;
+}
+
+void SortedLabeler::label_points(const vector<SynapsePoint>& points,
+        vector<unsigned long long>& labels, LookupStats& stats)
+{
+    vector<SortKey> keys(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        const SynapsePoint& point = points[i];
+        keys[i].code = DVIDUtils::morton_code(point.x / block_size,
+                point.y / block_size, point.z / block_size);
+        keys[i].x = point.x;
+        keys[i].y = point.y;
+        keys[i].z = point.z;
+        keys[i].index = i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // identical points are adjacent after sorting
+    vector<SynapsePoint> unique_points;
+    vector<size_t> unique_slot(points.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if ((i == 0) || !keys[i].same_point(keys[i-1])) {
+            unique_points.push_back(points[keys[i].index]);
+        }
+        unique_slot[keys[i].index] = unique_points.size() - 1;
+    }
+    keys.clear();
+
+    stats.synapse_points += points.size();
+    stats.file_block_runs += block_runs(points, block_size);
+    stats.sorted_block_runs += block_runs(unique_points, block_size);
+
+    vector<unsigned long long> unique_labels;
+    labeler->label_points(unique_points, unique_labels, stats);
+
+    labels.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        labels[i] = unique_labels[unique_slot[i]];
+    }
+}
+
+}
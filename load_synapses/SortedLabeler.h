@@ -0,0 +1,46 @@
+/*!
+ * Wraps a lookup backend so that every distinct point is resolved
+ * once and points are sent in Z-order (Morton) of their block.
+ * Synapses often share coordinates (a PSD on another synapse's
+ * T-bar, repeated annotations) and cluster spatially, so this
+ * shrinks the lookup and keeps consecutive points in nearby blocks.
+*/
+
+#ifndef SORTEDLABELER_H
+#define SORTEDLABELER_H
+
+#include "Labeler.h"
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class SortedLabeler : public Labeler {
+  public:
+    /*!
+     * \param labeler backend resolving the distinct points
+     * \param block_size edge of the blocks points are ordered by
+    */
+    SortedLabeler(boost::shared_ptr<Labeler> labeler, unsigned int block_size) :
+        labeler(labeler), block_size(block_size) {}
+
+    /*!
+     * Sort the points by the Morton code of their block, collapse
+     * duplicates, resolve the distinct points with the backend and
+     * copy each label back to every copy of its point.
+     * \param points locations to resolve
+     * \param labels label of points[i] is written to labels[i]
+     * \param stats request, dedup and locality counters are added here
+    */
+    void label_points(const std::vector<SynapsePoint>& points,
+            std::vector<unsigned long long>& labels, LookupStats& stats);
+
+  private:
+    boost::shared_ptr<Labeler> labeler;
+    unsigned int block_size;
+};
+
+}
+
+#endif
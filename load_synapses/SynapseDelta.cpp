@@ -0,0 +1,126 @@
+#include "SynapseDelta.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+using std::vector;
+
+namespace DVIDLoadSynapses {
+
+SynapseDelta::SynapseDelta(const SynapseGraph& added, const SynapseGraph& removed,
+        const SynapseGraph* merged) : added(added), removed(removed), merged(merged)
+{
+    const vector<unsigned long long>& added_ids = added.get_vertices();
+    const vector<unsigned long long>& removed_ids = removed.get_vertices();
+    std::set_union(added_ids.begin(), added_ids.end(), removed_ids.begin(),
+            removed_ids.end(), std::back_inserter(vertex_ids));
+    kept_partners.assign(vertex_ids.size(), 0);
+    clamped_counts.assign(vertex_ids.size(), 0);
+}
+
+unsigned long long SynapseDelta::get_kept_partners() const
+{
+    return std::accumulate(kept_partners.begin(), kept_partners.end(), 0ULL);
+}
+
+unsigned long long SynapseDelta::get_clamped_counts() const
+{
+    return std::count(clamped_counts.begin(), clamped_counts.end(), 1);
+}
+
+libdvid::BinaryDataPtr SynapseDelta::update(size_t i, libdvid::BinaryDataPtr current)
+{
+    unsigned long long id = vertex_ids[i];
+
+    // stored layout: count, number of partners, partner ids
+    unsigned long long count = 0;
+    vector<unsigned long long> partners;
+    if (current && current->length() > 0) {
+        const unsigned char* data = current->get_raw();
+        unsigned long long header[2] = { 0, 0 };
+        if (current->length() >= sizeof(header)) {
+            memcpy(header, data, sizeof(header));
+        }
+        if ((current->length() < sizeof(header)) || (current->length() !=
+                    sizeof(header) + header[1] * sizeof(unsigned long long))) {
+            std::ostringstream sstr;
+            sstr << "stored synapse property of body " << id << " is malformed";
+            throw std::runtime_error(sstr.str());
+        }
+        count = header[0];
+        partners.resize(header[1]);
+        if (header[1]) {
+            memcpy(&partners[0], data + sizeof(header),
+                    partners.size() * sizeof(unsigned long long));
+        }
+        std::sort(partners.begin(), partners.end());
+    }
+    vector<unsigned long long> old_partners(partners);
+
+    unsigned long long new_count = count;
+    size_t a = added.find_vertex(id);
+    if (a < added.num_vertices()) {
+        new_count += added.get_count(a);
+        partners.insert(partners.end(), added.partners(a),
+                added.partners(a) + added.num_partners(a));
+    }
+
+    unsigned long long kept = 0;
+    bool clamped = false;
+    vector<unsigned long long> dropped;
+    size_t r = removed.find_vertex(id);
+    if (r < removed.num_vertices()) {
+        if (removed.get_count(r) > new_count) {
+            clamped = true;
+            new_count = 0;
+        } else {
+            new_count -= removed.get_count(r);
+        }
+
+        // a partner goes only once no synapse with it is left
+        size_t m = merged ? merged->find_vertex(id) : 0;
+        for (size_t k = 0; k < removed.num_partners(r); ++k) {
+            unsigned long long partner = removed.partners(r)[k];
+            if (!merged) {
+                ++kept;
+            } else if ((m == merged->num_vertices()) ||
+                    (merged->get_weight(m, partner) == 0)) {
+                dropped.push_back(partner);
+            }
+        }
+    }
+
+    std::sort(partners.begin(), partners.end());
+    partners.erase(std::unique(partners.begin(), partners.end()), partners.end());
+    if (!dropped.empty()) {
+        vector<unsigned long long> remaining;
+        std::set_difference(partners.begin(), partners.end(), dropped.begin(),
+                dropped.end(), std::back_inserter(remaining));
+        partners.swap(remaining);
+    }
+
+    // a retried vertex overwrites the result of its earlier attempt
+    kept_partners[i] = kept;
+    clamped_counts[i] = clamped ? 1 : 0;
+
+    if ((new_count == count) && (partners == old_partners)) {
+        return libdvid::BinaryDataPtr();
+    }
+
+    unsigned long long header[2] = { new_count, partners.size() };
+    size_t partner_bytes = partners.size() * sizeof(unsigned long long);
+    libdvid::BinaryDataPtr payload = libdvid::BinaryData::create_binary_data(0, 0);
+    payload->get_data().resize(sizeof(header) + partner_bytes);
+    char* pos = &(payload->get_data()[0]);
+    memcpy(pos, header, sizeof(header));
+    if (partner_bytes) {
+        memcpy(pos + sizeof(header), &partners[0], partner_bytes);
+    }
+    return payload;
+}
+
+}
@@ -0,0 +1,67 @@
+/*!
+ * Applies added and removed synapses to the synapse properties
+ * already stored for a body.  Only bodies touched by the change are
+ * visited and a property is rewritten only if it changes.
+ *
+ * Counts are always exact.  A partner is dropped only when the pair
+ * weights of the full graph show that no synapse between the two
+ * bodies is left, so removals need the graph merged from the
+ * previous connectivity file; without it partners are kept and the
+ * number of such kept pairs is reported.
+*/
+
+#ifndef SYNAPSEDELTA_H
+#define SYNAPSEDELTA_H
+
+#include "SynapseGraph.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class SynapseDelta {
+  public:
+    /*!
+     * \param added graph of the added synapses
+     * \param removed graph of the removed synapses
+     * \param merged full graph after the change (optional)
+    */
+    SynapseDelta(const SynapseGraph& added, const SynapseGraph& removed,
+            const SynapseGraph* merged);
+
+    //! bodies with added or removed synapses, sorted
+    const std::vector<unsigned long long>& get_vertices() const
+    {
+        return vertex_ids;
+    }
+
+    /*!
+     * New property of vertex i given its stored property.  Different
+     * vertices can be updated concurrently; a vertex updated again
+     * after a conflict replaces its earlier result in the counts.
+     * Throws std::runtime_error if the stored property is malformed.
+     * \return null pointer if the property does not change
+    */
+    libdvid::BinaryDataPtr update(size_t i, libdvid::BinaryDataPtr current);
+
+    //! partners of removed synapses kept for lack of pair weights
+    unsigned long long get_kept_partners() const;
+
+    //! counts that would have gone negative and were set to zero
+    unsigned long long get_clamped_counts() const;
+
+  private:
+    const SynapseGraph& added;
+    const SynapseGraph& removed;
+    const SynapseGraph* merged;
+    std::vector<unsigned long long> vertex_ids;
+
+    //! result of the last update of each vertex
+    std::vector<unsigned long long> kept_partners;
+    std::vector<char> clamped_counts;
+};
+
+}
+
+#endif
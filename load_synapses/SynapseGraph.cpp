@@ -0,0 +1,415 @@
+#include "SynapseGraph.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::vector;
+
+namespace DVIDLoadSynapses {
+
+static const char GRAPH_MAGIC[8] = { 'S', 'Y', 'N', 'C', 'S', 'R', '0', '1' };
+
+// the edge list is compacted once it doubles (and holds at least this many)
+static const size_t MIN_COMPACT_EDGES = 1 << 20;
+// smaller lists are sorted on one thread
+static const size_t MIN_PARALLEL_SORT = 1 << 16;
+
+template <typename T>
+static void sort_range(T* begin, T* end)
+{
+    std::sort(begin, end);
+}
+
+template <typename T>
+static void merge_ranges(T* begin, T* middle, T* end)
+{
+    std::inplace_merge(begin, middle, end);
+}
+
+/*!
+ * Sort by sorting num_threads pieces concurrently and merging
+ * neighboring pieces pairwise, also concurrently.
+*/
+template <typename T>
+static void parallel_sort(vector<T>& items, int num_threads)
+{
+    if ((num_threads <= 1) || (items.size() < MIN_PARALLEL_SORT)) {
+        std::sort(items.begin(), items.end());
+        return;
+    }
+
+    T* base = &items[0];
+    vector<size_t> bounds;
+    for (int i = 0; i <= num_threads; ++i) {
+        bounds.push_back(items.size() * i / num_threads);
+    }
+
+    boost::thread_group sort_threads;
+    for (int i = 0; i < num_threads; ++i) {
+        sort_threads.create_thread(boost::bind(&sort_range<T>, base + bounds[i],
+                    base + bounds[i+1]));
+    }
+    sort_threads.join_all();
+
+    for (size_t width = 1; width < (size_t) num_threads; width *= 2) {
+        boost::thread_group merge_threads;
+        for (size_t i = 0; i + width < (size_t) num_threads; i += 2 * width) {
+            size_t end = std::min(i + 2 * width, (size_t) num_threads);
+            merge_threads.create_thread(boost::bind(&merge_ranges<T>, base + bounds[i],
+                        base + bounds[i + width], base + bounds[end]));
+        }
+        merge_threads.join_all();
+    }
+}
+
+void SynapseGraph::add_batch(const SynapseSet& synapses,
+        const vector<unsigned long long>& labels)
+{
+    for (size_t i = 0; i < synapses.num_synapses(); ++i) {
+        synapse_labels.clear();
+        for (size_t p = synapses.synapse_begin(i); p < synapses.synapse_end(i); ++p) {
+            unsigned long long label = labels[p];
+            if (label) {
+                synapse_labels.push_back(label);
+                counts[label]++;
+            }
+        }
+
+        // every pair of distinct bodies in the synapse are partners
+        std::sort(synapse_labels.begin(), synapse_labels.end());
+        synapse_labels.erase(std::unique(synapse_labels.begin(), synapse_labels.end()),
+                synapse_labels.end());
+        for (size_t it1 = 0; it1 < synapse_labels.size(); ++it1) {
+            for (size_t it2 = it1 + 1; it2 < synapse_labels.size(); ++it2) {
+                Edge edge = { synapse_labels[it1], synapse_labels[it2], 1 };
+                edges.push_back(edge);
+            }
+        }
+
+        if (edges.size() >= std::max(2 * compacted_edges, MIN_COMPACT_EDGES)) {
+            compact_edges();
+        }
+    }
+}
+
+void SynapseGraph::compact_edges()
+{
+    parallel_sort(edges, num_threads);
+
+    // merge repeated pairs, adding their weights
+    size_t kept = 0;
+    for (size_t e = 0; e < edges.size(); ++e) {
+        if ((kept > 0) && edges[e].same_pair(edges[kept - 1])) {
+            edges[kept - 1].weight += edges[e].weight;
+        } else {
+            edges[kept++] = edges[e];
+        }
+    }
+    edges.resize(kept);
+    compacted_edges = edges.size();
+}
+
+void SynapseGraph::build()
+{
+    compact_edges();
+
+    vertex_ids.clear();
+    vertex_ids.reserve(counts.size());
+    for (std::tr1::unordered_map<unsigned long long, unsigned long long>::iterator iter =
+            counts.begin(); iter != counts.end(); ++iter) {
+        vertex_ids.push_back(iter->first);
+    }
+    std::sort(vertex_ids.begin(), vertex_ids.end());
+    vertex_counts.resize(vertex_ids.size());
+    for (size_t i = 0; i < vertex_ids.size(); ++i) {
+        vertex_counts[i] = counts[vertex_ids[i]];
+    }
+    counts.clear();
+
+    // row of each edge end (every end has a count so it is a vertex)
+    vector<size_t> rows_a(edges.size()), rows_b(edges.size());
+    for (size_t e = 0; e < edges.size(); ++e) {
+        rows_a[e] = std::lower_bound(vertex_ids.begin(), vertex_ids.end(),
+                edges[e].a) - vertex_ids.begin();
+        rows_b[e] = std::lower_bound(vertex_ids.begin(), vertex_ids.end(),
+                edges[e].b) - vertex_ids.begin();
+    }
+
+    offsets.assign(vertex_ids.size() + 1, 0);
+    for (size_t e = 0; e < edges.size(); ++e) {
+        ++offsets[rows_a[e] + 1];
+        ++offsets[rows_b[e] + 1];
+    }
+    for (size_t i = 0; i < vertex_ids.size(); ++i) {
+        offsets[i+1] += offsets[i];
+    }
+
+    // edges are sorted by (a, b), so a vertex first receives its smaller
+    // partners in order and then its larger ones: rows come out sorted
+    neighbors.resize(2 * edges.size());
+    weights.resize(2 * edges.size());
+    vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t e = 0; e < edges.size(); ++e) {
+        weights[fill[rows_a[e]]] = edges[e].weight;
+        neighbors[fill[rows_a[e]]++] = edges[e].b;
+        weights[fill[rows_b[e]]] = edges[e].weight;
+        neighbors[fill[rows_b[e]]++] = edges[e].a;
+    }
+
+    vector<Edge>().swap(edges);
+    compacted_edges = 0;
+}
+
+// pair weight change while merging graphs
+struct WeightDelta {
+    unsigned long long a, b;
+    long long weight;
+
+    bool operator<(const WeightDelta& other) const
+    {
+        return (a != other.a) ? (a < other.a) : (b < other.b);
+    }
+};
+
+// add the counts and pairs (once each, a < b) of a graph with a sign
+static void add_signed(const SynapseGraph& graph, int sign,
+        std::tr1::unordered_map<unsigned long long, long long>& counts,
+        vector<WeightDelta>& deltas)
+{
+    for (size_t i = 0; i < graph.num_vertices(); ++i) {
+        unsigned long long id = graph.get_vertex(i);
+        counts[id] += sign * (long long) graph.get_count(i);
+        const unsigned long long* partners = graph.partners(i);
+        const unsigned long long* weights = graph.partner_weights(i);
+        for (size_t k = 0; k < graph.num_partners(i); ++k) {
+            if (partners[k] > id) {
+                WeightDelta delta = { id, partners[k], sign * (long long) weights[k] };
+                deltas.push_back(delta);
+            }
+        }
+    }
+}
+
+unsigned long long SynapseGraph::merge(const SynapseGraph& base,
+        const SynapseGraph& added, const SynapseGraph& removed)
+{
+    std::tr1::unordered_map<unsigned long long, long long> signed_counts;
+    vector<WeightDelta> deltas;
+    add_signed(base, 1, signed_counts, deltas);
+    add_signed(added, 1, signed_counts, deltas);
+    add_signed(removed, -1, signed_counts, deltas);
+
+    unsigned long long inconsistent = 0;
+    counts.clear();
+    for (std::tr1::unordered_map<unsigned long long, long long>::iterator iter =
+            signed_counts.begin(); iter != signed_counts.end(); ++iter) {
+        if (iter->second > 0) {
+            counts[iter->first] = iter->second;
+        } else if (iter->second < 0) {
+            ++inconsistent;
+        }
+    }
+
+    parallel_sort(deltas, num_threads);
+    edges.clear();
+    size_t pos = 0;
+    while (pos < deltas.size()) {
+        long long weight = 0;
+        size_t end = pos;
+        for (; (end < deltas.size()) && (deltas[end].a == deltas[pos].a) &&
+                (deltas[end].b == deltas[pos].b); ++end) {
+            weight += deltas[end].weight;
+        }
+        // a pair can only survive between bodies that still have synapses
+        if ((weight < 0) || ((weight > 0) && (!counts.count(deltas[pos].a) ||
+                        !counts.count(deltas[pos].b)))) {
+            ++inconsistent;
+        } else if (weight > 0) {
+            Edge edge = { deltas[pos].a, deltas[pos].b, (unsigned long long) weight };
+            edges.push_back(edge);
+        }
+        pos = end;
+    }
+
+    build();
+    return inconsistent;
+}
+
+size_t SynapseGraph::find_vertex(unsigned long long id) const
+{
+    vector<unsigned long long>::const_iterator iter =
+        std::lower_bound(vertex_ids.begin(), vertex_ids.end(), id);
+    if ((iter == vertex_ids.end()) || (*iter != id)) {
+        return vertex_ids.size();
+    }
+    return iter - vertex_ids.begin();
+}
+
+unsigned long long SynapseGraph::get_weight(size_t i, unsigned long long partner) const
+{
+    const unsigned long long* begin = partners(i);
+    const unsigned long long* end = begin + num_partners(i);
+    const unsigned long long* iter = std::lower_bound(begin, end, partner);
+    if ((iter == end) || (*iter != partner)) {
+        return 0;
+    }
+    return weights[offsets[i] + (iter - begin)];
+}
+
+unsigned long long SynapseGraph::total_weight() const
+{
+    unsigned long long total = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        total += weights[i];
+    }
+    return total / 2;
+}
+
+// write a whole buffer, retrying short writes
+static bool write_all(int fd, const void* data, size_t size)
+{
+    const char* pos = (const char*) data;
+    while (size > 0) {
+        ssize_t written = write(fd, pos, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        pos += written;
+        size -= written;
+    }
+    return true;
+}
+
+template <typename T>
+static bool write_vector(int fd, const vector<T>& items)
+{
+    return items.empty() || write_all(fd, &items[0], items.size() * sizeof(T));
+}
+
+bool SynapseGraph::save(std::string filename, std::string& error) const
+{
+    std::string tmp_filename = filename + ".tmp";
+    int fd = ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = strerror(errno);
+        return false;
+    }
+
+    unsigned long long header[2] = { vertex_ids.size(), neighbors.size() };
+    vector<unsigned long long> file_offsets(offsets.begin(), offsets.end());
+
+    bool ok = write_all(fd, GRAPH_MAGIC, sizeof(GRAPH_MAGIC)) &&
+        write_all(fd, header, sizeof(header)) &&
+        write_vector(fd, vertex_ids) && write_vector(fd, vertex_counts) &&
+        write_vector(fd, file_offsets) && write_vector(fd, neighbors) &&
+        write_vector(fd, weights) && (fsync(fd) == 0);
+    if (!ok) {
+        error = strerror(errno);
+    }
+    if (::close(fd) != 0 && ok) {
+        error = strerror(errno);
+        ok = false;
+    }
+    if (ok && rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        error = strerror(errno);
+        ok = false;
+    }
+    if (!ok) {
+        unlink(tmp_filename.c_str());
+    }
+    return ok;
+}
+
+// read a whole buffer, failing on a short read
+static bool read_all(int fd, void* data, size_t size)
+{
+    char* pos = (char*) data;
+    while (size > 0) {
+        ssize_t num_read = read(fd, pos, size);
+        if (num_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (num_read <= 0) {
+            return false;
+        }
+        pos += num_read;
+        size -= num_read;
+    }
+    return true;
+}
+
+template <typename T>
+static bool read_vector(int fd, vector<T>& items, size_t size)
+{
+    items.resize(size);
+    return items.empty() || read_all(fd, &items[0], size * sizeof(T));
+}
+
+bool SynapseGraph::load(std::string filename, std::string& error)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot be opened";
+        return false;
+    }
+
+    char magic[sizeof(GRAPH_MAGIC)];
+    unsigned long long header[2];
+    if (!read_all(fd, magic, sizeof(magic)) ||
+            memcmp(magic, GRAPH_MAGIC, sizeof(GRAPH_MAGIC)) != 0 ||
+            !read_all(fd, header, sizeof(header))) {
+        ::close(fd);
+        error = "not a connectivity file";
+        return false;
+    }
+
+    // check the size before allocating anything
+    off_t expected = sizeof(GRAPH_MAGIC) + sizeof(header) +
+        (off_t) (3 * header[0] + 1 + 2 * header[1]) * sizeof(unsigned long long);
+    if (lseek(fd, 0, SEEK_END) != expected ||
+            lseek(fd, sizeof(GRAPH_MAGIC) + sizeof(header), SEEK_SET) < 0) {
+        ::close(fd);
+        error = "truncated or corrupt";
+        return false;
+    }
+
+    vector<unsigned long long> file_offsets;
+    bool ok = read_vector(fd, vertex_ids, header[0]) &&
+        read_vector(fd, vertex_counts, header[0]) &&
+        read_vector(fd, file_offsets, header[0] + 1) &&
+        read_vector(fd, neighbors, header[1]) &&
+        read_vector(fd, weights, header[1]);
+    ::close(fd);
+    if (!ok || file_offsets.back() != header[1]) {
+        error = "truncated or corrupt";
+        return false;
+    }
+    offsets.assign(file_offsets.begin(), file_offsets.end());
+    return true;
+}
+
+libdvid::BinaryDataPtr SynapseGraph::get_payload(size_t i) const
+{
+    unsigned long long header[2] = { vertex_counts[i], num_partners(i) };
+    size_t partner_bytes = num_partners(i) * sizeof(unsigned long long);
+
+    libdvid::BinaryDataPtr payload = libdvid::BinaryData::create_binary_data(0, 0);
+    payload->get_data().resize(sizeof(header) + partner_bytes);
+    char* pos = &(payload->get_data()[0]);
+    memcpy(pos, header, sizeof(header));
+    if (partner_bytes) {
+        memcpy(pos + sizeof(header), partners(i), partner_bytes);
+    }
+    return payload;
+}
+
+}
@@ -0,0 +1,172 @@
+/*!
+ * Synapse counts and partner graph of the bodies in a synapse file.
+ * Partner pairs are appended to a flat edge list while synapses are
+ * read, then sorted, merged and packed into compressed sparse rows
+ * (per body offsets into one neighbor array).  The weight of a pair
+ * is the number of synapses the two bodies share.
+ *
+ * The graph can be saved for analysis in a binary file that is
+ * simple to mmap.  All fields are little-endian uint64:
+ *
+ *   magic "SYNCSR01", num_vertices V, num_entries N,
+ *   vertex_ids[V], counts[V], offsets[V+1],
+ *   neighbors[N], weights[N]
+ *
+ * Rows are symmetric (each pair appears in both bodies' rows) and
+ * sorted by neighbor id.
+*/
+
+#ifndef SYNAPSEGRAPH_H
+#define SYNAPSEGRAPH_H
+
+#include "SynapseSet.h"
+
+#include <libdvid/DVIDNodeService.h>
+#include <tr1/unordered_map>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class SynapseGraph {
+  public:
+    /*!
+     * \param num_threads threads used to sort the edge list
+    */
+    explicit SynapseGraph(int num_threads) : num_threads(num_threads),
+        compacted_edges(0) {}
+
+    /*!
+     * Count the labeled points of each body and connect the bodies
+     * that take part in the same synapse (T-bar to PSD and PSD to
+     * PSD).  A synapse adds one to the weight of each pair of
+     * distinct bodies it touches.  Unlabeled points are ignored.
+     * \param synapses batch of synapses
+     * \param labels label of every point in the batch
+    */
+    void add_batch(const SynapseSet& synapses, const std::vector<unsigned long long>& labels);
+
+    //! build the compressed rows; no synapses can be added afterwards
+    void build();
+
+    /*!
+     * Build this graph as base + added - removed: counts and pair
+     * weights are combined and bodies or pairs that drop to zero
+     * are removed.  The inputs must be built.
+     * \return counts or weights that would have gone negative (the
+     * removed synapses were not all in base); these are dropped
+    */
+    unsigned long long merge(const SynapseGraph& base, const SynapseGraph& added,
+            const SynapseGraph& removed);
+
+    //! bodies with at least one labeled point, sorted by id
+    size_t num_vertices() const
+    {
+        return vertex_ids.size();
+    }
+
+    unsigned long long get_vertex(size_t i) const
+    {
+        return vertex_ids[i];
+    }
+
+    const std::vector<unsigned long long>& get_vertices() const
+    {
+        return vertex_ids;
+    }
+
+    //! index of the body, or num_vertices() if it has no synapses
+    size_t find_vertex(unsigned long long id) const;
+
+    //! number of T-bars and PSDs on the body
+    unsigned long long get_count(size_t i) const
+    {
+        return vertex_counts[i];
+    }
+
+    //! partners of vertex i are neighbors[offsets[i], offsets[i+1]), sorted
+    size_t num_partners(size_t i) const
+    {
+        return offsets[i+1] - offsets[i];
+    }
+
+    const unsigned long long* partners(size_t i) const
+    {
+        return neighbors.empty() ? 0 : &neighbors[offsets[i]];
+    }
+
+    //! synapses shared with each partner, aligned with partners(i)
+    const unsigned long long* partner_weights(size_t i) const
+    {
+        return weights.empty() ? 0 : &weights[offsets[i]];
+    }
+
+    //! synapses vertex i shares with the partner (0 if none)
+    unsigned long long get_weight(size_t i, unsigned long long partner) const;
+
+    //! number of distinct partner pairs
+    size_t num_edges() const
+    {
+        return neighbors.size() / 2;
+    }
+
+    //! sum of the pair weights
+    unsigned long long total_weight() const;
+
+    /*!
+     * Write the graph in the binary layout described above.  The
+     * file is written under a temporary name and renamed into place.
+     * \return false if the file cannot be written
+    */
+    bool save(std::string filename, std::string& error) const;
+
+    /*!
+     * Read a graph written by save.
+     * \return false if the file cannot be read or is not a graph file
+    */
+    bool load(std::string filename, std::string& error);
+
+    /*!
+     * Property stored for vertex i: count, number of partners and
+     * the partner ids, each as a 64 bit integer.
+    */
+    libdvid::BinaryDataPtr get_payload(size_t i) const;
+
+  private:
+    //! partner pair with a < b and the synapses it was seen in
+    struct Edge {
+        unsigned long long a, b;
+        unsigned long long weight;
+
+        bool operator<(const Edge& other) const
+        {
+            return (a != other.a) ? (a < other.a) : (b < other.b);
+        }
+
+        bool same_pair(const Edge& other) const
+        {
+            return (a == other.a) && (b == other.b);
+        }
+    };
+
+    void compact_edges();
+
+    int num_threads;
+
+    std::tr1::unordered_map<unsigned long long, unsigned long long> counts;
+    std::vector<Edge> edges;
+    //! edge count after the last compaction
+    size_t compacted_edges;
+    //! distinct labels of the synapse being added
+    std::vector<unsigned long long> synapse_labels;
+
+    std::vector<unsigned long long> vertex_ids;
+    std::vector<unsigned long long> vertex_counts;
+    std::vector<size_t> offsets;
+    std::vector<unsigned long long> neighbors;
+    std::vector<unsigned long long> weights;
+};
+
+}
+
+#endif
@@ -0,0 +1,519 @@
+#include "SynapseReader.h"
+
+#include <cstdlib>
+#include <climits>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+namespace DVIDLoadSynapses {
+
+static const int END = std::char_traits<char>::eof();
+
+bool SynapseReader::open(string filename_, string& error)
+{
+    filename = filename_;
+    fin.open(filename.c_str(), std::ios::binary);
+    if (!fin) {
+        error = "cannot be opened";
+        return false;
+    }
+    buf = fin.rdbuf();
+    offset = 0;
+    first_synapse = true;
+    seen_data = false;
+
+    skip_ws();
+    if (!expect('{') || !seek_data(false)) {
+        error = error_msg;
+        return false;
+    }
+    return true;
+}
+
+bool SynapseReader::read_batch(size_t max_points, SynapseSet& batch, string& error)
+{
+    batch.clear();
+    while ((state == IN_DATA) && (batch.get_points().size() < max_points)) {
+        skip_ws();
+        if (peek() == ']') {
+            get();
+            // the rest of the top-level object is skipped
+            if (!seek_data(true)) {
+                error = error_msg;
+                return false;
+            }
+            break;
+        }
+        if (!first_synapse) {
+            if (!expect(',')) {
+                error = error_msg;
+                return false;
+            }
+            skip_ws();
+        }
+        first_synapse = false;
+
+        if (!parse_synapse(batch)) {
+            error = error_msg;
+            return false;
+        }
+    }
+    return true;
+}
+
+void SynapseReader::skip_ws()
+{
+    int c = peek();
+    while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+        get();
+        c = peek();
+    }
+}
+
+bool SynapseReader::fail(string msg)
+{
+    std::ostringstream sstr;
+    sstr << "is not valid synapse json: " << msg << " at byte " << offset;
+    error_msg = sstr.str();
+    return false;
+}
+
+bool SynapseReader::expect(char c)
+{
+    int next = peek();
+    if (next != c) {
+        if (next == END) {
+            return fail("unexpected end of file");
+        }
+        return fail(string("expected '") + c + "'");
+    }
+    get();
+    return true;
+}
+
+/*
+ * Scan the members of the top-level object until the "data" list
+ * starts or the object ends.
+*/
+bool SynapseReader::seek_data(bool after_member)
+{
+    while (true) {
+        skip_ws();
+        if (peek() == '}') {
+            get();
+            state = DONE;
+            return true;
+        }
+        if (after_member) {
+            if (!expect(',')) {
+                return false;
+            }
+            skip_ws();
+        }
+        after_member = true;
+
+        string key;
+        if (!parse_string(&key)) {
+            return false;
+        }
+        skip_ws();
+        if (!expect(':')) {
+            return false;
+        }
+        skip_ws();
+
+        if (key != "data") {
+            if (!skip_value()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (seen_data) {
+            return fail("more than one data list");
+        }
+        seen_data = true;
+        if (peek() == '[') {
+            get();
+            state = IN_DATA;
+            first_synapse = true;
+            return true;
+        }
+        if (!at_null()) {
+            return fail("data must be a list of synapses");
+        }
+    }
+}
+
+bool SynapseReader::parse_synapse(SynapseSet& batch)
+{
+    if (peek() != '{') {
+        if (!at_null()) {
+            return fail("synapse must be an object");
+        }
+        batch.add_synapse();
+        return true;
+    }
+    get();
+
+    // the T-bar comes first whatever the member order is
+    SynapsePoint tbar;
+    bool has_tbar = false;
+    psd_scratch.clear();
+
+    bool after_member = false;
+    while (true) {
+        skip_ws();
+        if (peek() == '}') {
+            get();
+            break;
+        }
+        if (after_member) {
+            if (!expect(',')) {
+                return false;
+            }
+            skip_ws();
+        }
+        after_member = true;
+
+        string key;
+        if (!parse_string(&key)) {
+            return false;
+        }
+        skip_ws();
+        if (!expect(':')) {
+            return false;
+        }
+        skip_ws();
+
+        bool ok;
+        if (key == "T-bar") {
+            ok = parse_tbar(tbar, has_tbar);
+        } else if (key == "partners") {
+            psd_scratch.clear();
+            ok = parse_partners(psd_scratch);
+        } else {
+            ok = skip_value();
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    batch.add_synapse();
+    if (has_tbar) {
+        batch.add_point(tbar);
+    }
+    for (size_t i = 0; i < psd_scratch.size(); ++i) {
+        batch.add_point(psd_scratch[i]);
+    }
+    return true;
+}
+
+bool SynapseReader::parse_tbar(SynapsePoint& point, bool& found)
+{
+    found = false;
+    if (peek() != '{') {
+        return skip_value();
+    }
+    get();
+
+    bool after_member = false;
+    while (true) {
+        skip_ws();
+        if (peek() == '}') {
+            get();
+            return true;
+        }
+        if (after_member) {
+            if (!expect(',')) {
+                return false;
+            }
+            skip_ws();
+        }
+        after_member = true;
+
+        string key;
+        if (!parse_string(&key)) {
+            return false;
+        }
+        skip_ws();
+        if (!expect(':')) {
+            return false;
+        }
+        skip_ws();
+
+        if (!((key == "location") ? parse_location(point, found) : skip_value())) {
+            return false;
+        }
+    }
+}
+
+bool SynapseReader::parse_partners(vector<SynapsePoint>& psds)
+{
+    if (peek() != '[') {
+        return skip_value();
+    }
+    get();
+
+    bool after_element = false;
+    while (true) {
+        skip_ws();
+        if (peek() == ']') {
+            get();
+            return true;
+        }
+        if (after_element) {
+            if (!expect(',')) {
+                return false;
+            }
+            skip_ws();
+        }
+        after_element = true;
+
+        // a partner is parsed like a T-bar
+        SynapsePoint point;
+        bool found;
+        if (!parse_tbar(point, found)) {
+            return false;
+        }
+        if (found) {
+            psds.push_back(point);
+        }
+    }
+}
+
+bool SynapseReader::parse_location(SynapsePoint& point, bool& found)
+{
+    found = false;
+    if (peek() != '[') {
+        if (at_null()) {
+            return true;
+        }
+        return fail("location must be a list");
+    }
+    get();
+
+    unsigned int coords[3];
+    int num_coords = 0;
+    while (true) {
+        skip_ws();
+        if (peek() == ']') {
+            get();
+            break;
+        }
+        if (num_coords > 0) {
+            if (!expect(',')) {
+                return false;
+            }
+            skip_ws();
+        }
+
+        // anything past z is ignored
+        if (num_coords < 3) {
+            if (!parse_coordinate(coords[num_coords])) {
+                return false;
+            }
+        } else if (!skip_value()) {
+            return false;
+        }
+        ++num_coords;
+    }
+
+    if (num_coords == 0) {
+        return true;
+    }
+    if (num_coords < 3) {
+        return fail("location needs x, y and z");
+    }
+    point = SynapsePoint(coords[0], coords[1], coords[2]);
+    found = true;
+    return true;
+}
+
+bool SynapseReader::parse_coordinate(unsigned int& val)
+{
+    string number;
+    if (!parse_number(number)) {
+        return false;
+    }
+
+    // fractions are truncated as jsoncpp's asUInt does
+    char* end;
+    double dval = strtod(number.c_str(), &end);
+    if ((*end != '\0') || (dval < 0) || (dval > UINT_MAX)) {
+        return fail("coordinate must be a non-negative number");
+    }
+    if (number.find_first_not_of("0123456789") == string::npos) {
+        val = (unsigned int) strtoul(number.c_str(), 0, 10);
+    } else {
+        val = (unsigned int) dval;
+    }
+    return true;
+}
+
+// read a string, storing its decoded value in out if given
+bool SynapseReader::parse_string(string* out)
+{
+    if (!expect('"')) {
+        return false;
+    }
+    while (true) {
+        int c = get();
+        if (c == END) {
+            return fail("unterminated string");
+        }
+        if (c == '"') {
+            return true;
+        }
+        if (c < 0x20) {
+            return fail("control character in string");
+        }
+        if (c != '\\') {
+            if (out) {
+                out->push_back((char) c);
+            }
+            continue;
+        }
+
+        c = get();
+        char decoded;
+        switch (c) {
+          case '"': decoded = '"'; break;
+          case '\\': decoded = '\\'; break;
+          case '/': decoded = '/'; break;
+          case 'b': decoded = '\b'; break;
+          case 'f': decoded = '\f'; break;
+          case 'n': decoded = '\n'; break;
+          case 'r': decoded = '\r'; break;
+          case 't': decoded = '\t'; break;
+          case 'u': {
+            unsigned int code = 0;
+            for (int i = 0; i < 4; ++i) {
+                int h = get();
+                if (h >= '0' && h <= '9') {
+                    code = code * 16 + (h - '0');
+                } else if (h >= 'a' && h <= 'f') {
+                    code = code * 16 + (h - 'a' + 10);
+                } else if (h >= 'A' && h <= 'F') {
+                    code = code * 16 + (h - 'A' + 10);
+                } else {
+                    return fail("bad unicode escape");
+                }
+            }
+            // utf-8 encode (keys that matter are plain ascii)
+            if (out) {
+                if (code < 0x80) {
+                    out->push_back((char) code);
+                } else if (code < 0x800) {
+                    out->push_back((char) (0xc0 | (code >> 6)));
+                    out->push_back((char) (0x80 | (code & 0x3f)));
+                } else {
+                    out->push_back((char) (0xe0 | (code >> 12)));
+                    out->push_back((char) (0x80 | ((code >> 6) & 0x3f)));
+                    out->push_back((char) (0x80 | (code & 0x3f)));
+                }
+            }
+            continue;
+          }
+          default:
+            return fail("bad escape in string");
+        }
+        if (out) {
+            out->push_back(decoded);
+        }
+    }
+}
+
+bool SynapseReader::parse_literal(string& literal)
+{
+    int c = peek();
+    while (c >= 'a' && c <= 'z') {
+        literal.push_back((char) get());
+        c = peek();
+    }
+    if (literal != "true" && literal != "false" && literal != "null") {
+        return fail("unexpected token");
+    }
+    return true;
+}
+
+bool SynapseReader::parse_number(string& number)
+{
+    int c = peek();
+    while ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+            c == 'e' || c == 'E') {
+        number.push_back((char) get());
+        c = peek();
+    }
+    if (number.empty()) {
+        if (c == END) {
+            return fail("unexpected end of file");
+        }
+        return fail("expected a value");
+    }
+    return true;
+}
+
+// consume a null value if one is next
+bool SynapseReader::at_null()
+{
+    if (peek() != 'n') {
+        return false;
+    }
+    string literal;
+    return parse_literal(literal) && (literal == "null");
+}
+
+bool SynapseReader::skip_value()
+{
+    int c = peek();
+    if (c == '"') {
+        return parse_string(0);
+    }
+    if (c >= 'a' && c <= 'z') {
+        string literal;
+        return parse_literal(literal);
+    }
+    if (c != '{' && c != '[') {
+        string number;
+        return parse_number(number);
+    }
+
+    // objects and lists are skipped by matching brackets
+    get();
+    char close = (c == '{') ? '}' : ']';
+    bool after_element = false;
+    while (true) {
+        skip_ws();
+        if (peek() == close) {
+            get();
+            return true;
+        }
+        if (after_element) {
+            if (!expect(',')) {
+                return false;
+            }
+            skip_ws();
+        }
+        after_element = true;
+
+        if (close == '}') {
+            if (!parse_string(0)) {
+                return false;
+            }
+            skip_ws();
+            if (!expect(':')) {
+                return false;
+            }
+            skip_ws();
+        }
+        if (!skip_value()) {
+            return false;
+        }
+    }
+}
+
+}
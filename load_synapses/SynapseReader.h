@@ -0,0 +1,107 @@
+/*!
+ * Incremental reader for synapse json files.  Instead of building
+ * a document for the whole file, the reader walks the text once and
+ * returns the T-bar and PSD locations of the synapses in the "data"
+ * list a batch at a time, so memory is bounded by the batch size.
+ *
+ * Points are produced exactly as the DOM based loader did: per
+ * synapse the T-bar location (if any) followed by the location of
+ * every partner that has one.  All other members are skipped.
+*/
+
+#ifndef SYNAPSEREADER_H
+#define SYNAPSEREADER_H
+
+#include "SynapseSet.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace DVIDLoadSynapses {
+
+class SynapseReader {
+  public:
+    SynapseReader() : buf(0), offset(0), state(DONE), first_synapse(true),
+        seen_data(false) {}
+
+    /*!
+     * Open the file and read up to the start of the synapse list.
+     * \param filename_ synapse json file
+     * \param error reason the file cannot be read
+     * \return false on error
+    */
+    bool open(std::string filename_, std::string& error);
+
+    std::string get_filename() const
+    {
+        return filename;
+    }
+
+    //! true once the synapse list has been read completely
+    bool done() const
+    {
+        return state == DONE;
+    }
+
+    /*!
+     * Read the next synapses.  Whole synapses are added until the
+     * batch holds at least max_points points or the list ends.
+     * \param max_points target number of points in the batch
+     * \param batch cleared and filled with the synapses read
+     * \param error reason the file cannot be parsed
+     * \return false on error
+    */
+    bool read_batch(size_t max_points, SynapseSet& batch, std::string& error);
+
+  private:
+    enum State { IN_DATA, DONE };
+
+    int peek()
+    {
+        return buf->sgetc();
+    }
+
+    int get()
+    {
+        int c = buf->sbumpc();
+        if (c != std::char_traits<char>::eof()) {
+            ++offset;
+        }
+        return c;
+    }
+
+    void skip_ws();
+    bool fail(std::string msg);
+    bool expect(char c);
+
+    bool seek_data(bool after_member);
+    bool parse_synapse(SynapseSet& batch);
+    bool parse_tbar(SynapsePoint& point, bool& found);
+    bool parse_partners(std::vector<SynapsePoint>& psds);
+    bool parse_location(SynapsePoint& point, bool& found);
+    bool parse_coordinate(unsigned int& val);
+
+    bool parse_string(std::string* out);
+    bool parse_literal(std::string& literal);
+    bool parse_number(std::string& number);
+    bool skip_value();
+    bool at_null();
+
+    std::string filename;
+    std::ifstream fin;
+    std::streambuf* buf;
+    unsigned long long offset;
+    std::string error_msg;
+
+    State state;
+    bool first_synapse;
+    bool seen_data;
+
+    //! partners of the synapse being parsed
+    std::vector<SynapsePoint> psd_scratch;
+};
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*!
+ * Flat storage for the T-bar and PSD locations of a list of
+ * synapses.
+*/
+
+#ifndef SYNAPSESET_H
+#define SYNAPSESET_H
+
+#include <vector>
+#include <cstddef>
+
+namespace DVIDLoadSynapses {
+
+//! location of a T-bar or PSD in global DVID coordinates
+struct SynapsePoint {
+    SynapsePoint() : x(0), y(0), z(0) {}
+    SynapsePoint(unsigned int x_, unsigned int y_, unsigned int z_) :
+        x(x_), y(y_), z(z_) {}
+
+    unsigned int x, y, z;
+};
+
+/*!
+ * Points of all synapses stored back to back.  The points of a
+ * synapse are its T-bar (if it has a location) followed by its
+ * PSDs in file order.
+*/
+class SynapseSet {
+  public:
+    SynapseSet()
+    {
+        offsets.push_back(0);
+    }
+
+    //! start a new synapse; following points belong to it
+    void add_synapse()
+    {
+        offsets.push_back(points.size());
+    }
+
+    //! add a point to the last synapse
+    void add_point(const SynapsePoint& point)
+    {
+        points.push_back(point);
+        offsets.back() = points.size();
+    }
+
+    size_t num_synapses() const
+    {
+        return offsets.size() - 1;
+    }
+
+    //! points of synapse i are [synapse_begin(i), synapse_end(i))
+    size_t synapse_begin(size_t i) const
+    {
+        return offsets[i];
+    }
+
+    size_t synapse_end(size_t i) const
+    {
+        return offsets[i + 1];
+    }
+
+    const std::vector<SynapsePoint>& get_points() const
+    {
+        return points;
+    }
+
+    void clear()
+    {
+        points.clear();
+        offsets.clear();
+        offsets.push_back(0);
+    }
+
+  private:
+    std::vector<SynapsePoint> points;
+
+    //! synapse i ends at offsets[i+1]
+    std::vector<size_t> offsets;
+};
+
+}
+
+#endif
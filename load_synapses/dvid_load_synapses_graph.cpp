@@ -1,171 +1,302 @@
-#include <json/json.h>
-#include <json/value.h>
-
 #include <libdvid/DVIDNodeService.h>
 
+#include "OptionParser.h"
+#include "SynapseSet.h"
+#include "SynapseReader.h"
+#include "BlockLabeler.h"
+#include "PointQueryLabeler.h"
+#include "SortedLabeler.h"
+#include "SynapseGraph.h"
+#include "LookupPipeline.h"
+#include "PropertyWriter.h"
+#include "SynapseDelta.h"
+
 #include <iostream>
 #include <string>
-#include <fstream>
+#include <stdexcept>
 
 #include <vector>
-#include <tr1/unordered_map>
-#include <tr1/unordered_set>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
 
 using std::cout; using std::endl;
-using std::ifstream;
 
 using std::string;
-using std::tr1::unordered_map;
-using std::tr1::unordered_set;
 using std::vector;
 
-const char * USAGE = "<prog> <dvid-server> <uuid> <graph-name> <synapse-file> <label name>";
+using namespace DVIDLoadSynapses;
+
 const char * HELP = "Program takes a synapse file (in global DVID coordinates) and saves the counts and partners in the given graph";
 static const char * SYNAPSE_KEY = "synapse";
 
-int main(int argc, char** argv)
+struct BuildOptions
 {
-    if (argc != 6) {
-        cout << USAGE << endl;
-        cout << HELP << endl;
+    BuildOptions(int argc, char** argv) : no_compress(false), lookup("blocks"),
+        lookup_size(32), batch_size(1000), inflight(4), read_batch(1000000),
+        threads(1), vertex_batch(10000), write_inflight(4), max_retries(5),
+        delta(false)
+    {
+        DVIDUtils::OptionParser parser(HELP);
+
+        parser.add_positional(dvid_servername, "dvid-server", "name of dvid server");
+        parser.add_positional(uuid, "uuid", "dvid node uuid");
+        parser.add_positional(graph_name, "graph-name", "name of the labelgraph");
+        parser.add_positional(synapse_file, "synapse-file", "synapse json file");
+        parser.add_positional(label_name, "label-name", "name of the label volume");
+
+        parser.add_flag(no_compress, "no-compress",
+                "fetch label blocks uncompressed instead of lz4 compressed");
+        parser.add_option(lookup, "lookup",
+                "how point labels are found: blocks fetches the cube around groups of points, "
+                "points sends the coordinates to DVID's labels query");
+        parser.add_option(lookup_size, "lookup-size",
+                "edge of the aligned cube fetched to resolve the points inside it (1 fetches "
+                "each point); points are also sent in Morton order of these cubes");
+        parser.add_option(batch_size, "batch-size",
+                "points per labels query (points lookup)");
+        parser.add_option(inflight, "inflight",
+                "labels queries sent concurrently (points lookup)");
+        parser.add_option(read_batch, "read-batch",
+                "points read from the synapse file and resolved together (duplicates "
+                "within a batch are looked up once); at most 2 x threads batches are "
+                "held in memory");
+        parser.add_option(connectivity_file, "connectivity-file",
+                "also save the weighted partner graph (synapses per body pair) to this "
+                "binary file for analysis");
+        parser.add_option(threads, "threads",
+                "lookup workers, each with its own connection(s); results do not "
+                "depend on the number of workers");
+        parser.add_option(vertex_batch, "vertex-batch",
+                "vertex properties read and written per request");
+        parser.add_option(write_inflight, "write-inflight",
+                "vertex batches written concurrently");
+        parser.add_option(max_retries, "max-retries",
+                "times a vertex whose transaction conflicted is retried with a "
+                "fresh transaction id");
+
+        parser.add_flag(delta, "delta",
+                "synapse-file holds added synapses; update the stored properties of "
+                "the bodies involved instead of rewriting every body");
+        parser.add_option(removed_synapses, "removed-synapses",
+                "synapse json file of synapses removed since the last load (delta mode)");
+        parser.add_option(base_connectivity, "base-connectivity",
+                "connectivity file saved by the previous load; its pair weights tell "
+                "when the last synapse between two bodies is removed (delta mode)");
+
+        parser.parse_options(argc, argv);
+    }
+
+    string dvid_servername;
+    string uuid;
+    string graph_name;
+    string synapse_file;
+    string label_name;
+
+    bool no_compress;
+    string lookup;
+    int lookup_size;
+    int batch_size;
+    int inflight;
+    int read_batch;
+    string connectivity_file;
+    int threads;
+    int vertex_batch;
+    int write_inflight;
+    int max_retries;
+
+    bool delta;
+    string removed_synapses;
+    string base_connectivity;
+};
+
+/*!
+ * Read a synapse file through the lookup pipeline into a graph and
+ * build it.  Exits on error.
+*/
+void read_graph(string filename, LookupPipeline& pipeline, size_t read_batch,
+        SynapseGraph& graph, LookupStats& stats)
+{
+    SynapseReader reader;
+    string error;
+    if (!reader.open(filename, error)) {
+        cout << "Error: input file: " << filename << " " << error << endl;
         exit(1);
     }
-    
-    // create DVID node accessor 
-    libdvid::DVIDNodeService dvid_node(argv[1], argv[2]);
+    try {
+        pipeline.run(reader, read_batch, boost::bind(&SynapseGraph::add_batch,
+                    &graph, _1, _2), stats);
+    } catch (std::exception& e) {
+        cout << "Error: " << e.what() << endl;
+        exit(1);
+    }
+    graph.build();
+}
 
-    string graph_name = string(argv[3]);
-   
-    unordered_map<unsigned long long, unsigned long long> counts;
-    unordered_map<unsigned long long, unordered_set<unsigned long long> > partners;
+void print_graph(string name, const SynapseGraph& graph)
+{
+    cout << name << ": " << graph.num_vertices() << " bodies, "
+        << graph.num_edges() << " partner pairs, " << graph.total_weight()
+        << " synapse connections" << endl;
+}
 
-    // size and channel params for standard label rest call
-    libdvid::Dims_t sizes; sizes.push_back(1);
-    sizes.push_back(1); sizes.push_back(1);
+// property of vertex i is computed from the graph alone
+libdvid::BinaryDataPtr graph_payload(const SynapseGraph* graph, size_t i,
+        libdvid::BinaryDataPtr)
+{
+    return graph->get_payload(i);
+}
 
+int main(int argc, char** argv)
+{
+    BuildOptions options(argc, argv);
+    
+    // create DVID node accessor 
+    libdvid::DVIDNodeService dvid_node(options.dvid_servername, options.uuid);
 
-    // read synapse file
-    Json::Reader json_reader;
-    Json::Value json_reader_vals;
-    ifstream fin(argv[4]);
-    if (!fin) {
-        cout << "Error: input file: " << argv[4] << " cannot be opened" << endl;
+    string graph_name = options.graph_name;
+
+    if (options.lookup != "blocks" && options.lookup != "points") {
+        cout << "Error: lookup must be 'blocks' or 'points'" << endl;
         exit(1);
     }
-    if (!json_reader.parse(fin, json_reader_vals)) {
-        cout << "Error: Json incorrectly formatted" << endl;
+    if (options.lookup_size < 1) {
+        cout << "Error: lookup size must be positive" << endl;
         exit(1);
     }
-    fin.close();
-   
-    // iterate all synapses 
-    Json::Value synapses = json_reader_vals["data"];
-    for (int i = 0; i < synapses.size(); ++i) {
-        vector<unsigned int> constraint_list;
-
-        Json::Value location = synapses[i]["T-bar"]["location"];
-        if (!location.empty()) {
-            int xloc = location[(unsigned int)(0)].asUInt();
-            int yloc = location[(unsigned int)(1)].asUInt();
-            int zloc = location[(unsigned int)(2)].asUInt();
-            
-            // determine label corresponding to point
-            vector<unsigned int> start; start.push_back(xloc);
-            start.push_back(yloc); start.push_back(zloc);
-            
-            // retrieve volume 
-            libdvid::Labels3D labels = dvid_node.get_labels3D(argv[5], sizes, start);
-            unsigned long long* ptr = (unsigned long long int*) labels.get_raw();
-            unsigned long long label = *ptr;
-
-            if (label) {
-                constraint_list.push_back(label);
-                counts[label]++;
-            }
-        }
-        Json::Value psds = synapses[i]["partners"];
-        for (int i = 0; i < psds.size(); ++i) {
-            Json::Value location = psds[i]["location"];
-            if (!location.empty()) {
-                int xloc = location[(unsigned int)(0)].asUInt();
-                int yloc = location[(unsigned int)(1)].asUInt();
-                int zloc = location[(unsigned int)(2)].asUInt();
-            
-                // determine label corresponding to point
-                vector<unsigned int> start; start.push_back(xloc);
-                start.push_back(yloc); start.push_back(zloc);
-
-                // retrieve volume 
-                libdvid::Labels3D labels = dvid_node.get_labels3D(argv[5], sizes, start);
-                unsigned long long* ptr = (unsigned long long int*) labels.get_raw();
-                unsigned long long label = *ptr;
-
-                if (label) {
-                    constraint_list.push_back(label);
-                    counts[label]++;
-                }
-            }
-        }
-       
-        // load constraints for Tbar to PSD and PSD to PSD 
-        for (int it1 = 0; it1 < constraint_list.size(); ++it1) {
-            for (int it2 = (it1+1); it2 < constraint_list.size(); ++it2) {
-                if (constraint_list[it1] != constraint_list[it2]) {
-                    partners[(constraint_list[it1])].insert((constraint_list[it2]));
-                    partners[(constraint_list[it2])].insert((constraint_list[it1]));
-                }
-            }
+    if (options.batch_size < 1 || options.inflight < 1 || options.read_batch < 1 ||
+            options.threads < 1) {
+        cout << "Error: batch-size, inflight, read-batch and threads must be positive" << endl;
+        exit(1);
+    }
+    if (options.vertex_batch < 1 || options.write_inflight < 1 || options.max_retries < 0) {
+        cout << "Error: vertex-batch and write-inflight must be positive and "
+            "max-retries non-negative" << endl;
+        exit(1);
+    }
+    if (!options.delta && (!options.removed_synapses.empty() ||
+                !options.base_connectivity.empty())) {
+        cout << "Error: removed-synapses and base-connectivity need delta mode" << endl;
+        exit(1);
+    }
+    if (options.delta && !options.connectivity_file.empty() &&
+            options.base_connectivity.empty()) {
+        cout << "Error: delta mode can only save a connectivity file when given "
+            "the previous one (base-connectivity)" << endl;
+        exit(1);
+    }
+
+    // one labeler per lookup worker; each resolves the distinct points
+    // of a batch in Morton order
+    vector<boost::shared_ptr<libdvid::DVIDNodeService> > lookup_nodes;
+    vector<boost::shared_ptr<Labeler> > labelers;
+    for (int i = 0; i < options.threads; ++i) {
+        boost::shared_ptr<Labeler> backend;
+        if (options.lookup == "points") {
+            backend = boost::shared_ptr<Labeler>(new PointQueryLabeler(
+                        options.dvid_servername, options.uuid, options.label_name,
+                        options.batch_size, options.inflight));
+        } else {
+            lookup_nodes.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                        new libdvid::DVIDNodeService(options.dvid_servername,
+                            options.uuid)));
+            backend = boost::shared_ptr<Labeler>(new BlockLabeler(
+                        *lookup_nodes.back(), options.label_name,
+                        options.lookup_size, !options.no_compress));
         }
+        labelers.push_back(boost::shared_ptr<Labeler>(new SortedLabeler(backend,
+                        options.lookup_size)));
+    }
+
+    // determine the label under every point; batches are aggregated in file order
+    LookupPipeline pipeline(labelers, 2 * options.threads);
+    LookupStats lookup_stats;
+    SynapseGraph graph(options.threads);
+    read_graph(options.synapse_file, pipeline, options.read_batch, graph, lookup_stats);
+    SynapseGraph removed(options.threads);
+    if (!options.removed_synapses.empty()) {
+        read_graph(options.removed_synapses, pipeline, options.read_batch, removed,
+                lookup_stats);
     }
     cout << "Finished reading all synapses" << endl;
+    lookup_stats.print(cout);
+
+    // properties are serialized straight from the partner rows
+    string error;
+    PropertyWriter::UpdateFunction update = boost::bind(graph_payload, &graph, _1, _2);
+    const vector<unsigned long long>* vertex_ids = &graph.get_vertices();
+    SynapseGraph merged(options.threads);
+    boost::shared_ptr<SynapseDelta> delta;
 
-    // load vertex list and data
-    vector<libdvid::Vertex> vertices;
-    vector<libdvid::BinaryDataPtr> properties;
-    libdvid::VertexTransactions transaction_ids; 
-
-    // load property data for post
-    for (unordered_map<unsigned long long, unsigned long long>::iterator iter =
-            counts.begin(); iter != counts.end(); ++iter) {
-        vertices.push_back(libdvid::Vertex(iter->first, 0));
-
-        // set count and constraints 
-        unsigned long long num_partners = partners[iter->first].size();
-        int total_size = num_partners + 2;  
-        assert(sizeof(unsigned long long) == 8);
-
-        unsigned long long* data = new unsigned long long [total_size]; 
-        
-        int spot = 0; 
-        data[spot] = iter->second;
-        ++spot;
-        data[spot] = num_partners;
-        ++spot;
-        for (unordered_set<unsigned long long>::iterator iter2 =
-            partners[iter->first].begin(); iter2 != partners[iter->first].end(); ++iter2) {
-            data[spot] = *iter2;
-            ++spot;
+    if (!options.delta) {
+        print_graph("Partner graph", graph);
+        if (!options.connectivity_file.empty()) {
+            if (!graph.save(options.connectivity_file, error)) {
+                cout << "Error: connectivity file: " << options.connectivity_file << ": "
+                    << error << endl;
+                exit(1);
+            }
+            cout << "Wrote connectivity to " << options.connectivity_file << endl;
         }
+    } else {
+        print_graph("Added synapses", graph);
+        print_graph("Removed synapses", removed);
 
-        properties.push_back(libdvid::BinaryData::create_binary_data((char*) data,
-                    total_size*8));
+        // the full graph after the change decides which partners go
+        if (!options.base_connectivity.empty()) {
+            SynapseGraph base(options.threads);
+            if (!base.load(options.base_connectivity, error)) {
+                cout << "Error: connectivity file: " << options.base_connectivity << ": "
+                    << error << endl;
+                exit(1);
+            }
+            unsigned long long inconsistent = merged.merge(base, graph, removed);
+            print_graph("Updated partner graph", merged);
+            if (inconsistent) {
+                cout << "Warning: " << inconsistent << " counts or pair weights went "
+                    "negative; some removed synapses were not in the base connectivity"
+                    << endl;
+            }
+            if (!options.connectivity_file.empty()) {
+                if (!merged.save(options.connectivity_file, error)) {
+                    cout << "Error: connectivity file: " << options.connectivity_file
+                        << ": " << error << endl;
+                    exit(1);
+                }
+                cout << "Wrote connectivity to " << options.connectivity_file << endl;
+            }
+        }
 
-        delete []data;
+        delta = boost::shared_ptr<SynapseDelta>(new SynapseDelta(graph, removed,
+                    options.base_connectivity.empty() ? 0 : &merged));
+        update = boost::bind(&SynapseDelta::update, delta.get(), _1, _2);
+        vertex_ids = &delta->get_vertices();
+        cout << "Bodies touched: " << vertex_ids->size() << endl;
     }
     cout << "Finished processing all constraints" << endl;
 
-    // nominally use transaction protection to load data; this should be run by itself
-    vector<libdvid::BinaryDataPtr> properties_dummy;
-    // retrieve vertex transactions
-    dvid_node.get_properties(graph_name, vertices, SYNAPSE_KEY,
-            properties_dummy, transaction_ids);
-
-    // set vertex transactions
-    vector<libdvid::Vertex> leftover_vertices;
-    dvid_node.set_properties(graph_name, vertices, SYNAPSE_KEY, properties,
-            transaction_ids, leftover_vertices);
-
-    assert(leftover_vertices.size() == 0);
+    // write the properties in batches under transaction protection; a
+    // vertex changed by someone else in between is retried
+    PropertyWriter writer(options.dvid_servername, options.uuid, graph_name,
+            SYNAPSE_KEY, options.vertex_batch, options.write_inflight,
+            options.max_retries);
+    PropertyStats property_stats;
+    try {
+        writer.write(*vertex_ids, update, property_stats);
+    } catch (std::exception& e) {
+        property_stats.print(cout);
+        cout << "Error: property write failed: " << e.what() << endl;
+        exit(1);
+    }
+    property_stats.print(cout);
+    if (delta && delta->get_kept_partners()) {
+        cout << "Warning: " << delta->get_kept_partners() << " partners of removed "
+            "synapses were kept; give base-connectivity to drop partners that no "
+            "longer share a synapse" << endl;
+    }
+    if (delta && delta->get_clamped_counts()) {
+        cout << "Warning: " << delta->get_clamped_counts() << " bodies lost more "
+            "synapses than their stored count; their counts were set to zero" << endl;
+    }
 
     return 0;
 }
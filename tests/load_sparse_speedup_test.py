@@ -0,0 +1,62 @@
+"""
+Checks that dvid_load_sparse overlaps requests for chunks that do not
+share DVID blocks.  The body spans several z block rows and is loaded
+plane by plane; planes of the same block row have to be written one
+after another, but different rows are independent.  With a fixed
+latency per request, 8 threads must beat 1 thread clearly.
+
+usage: load_sparse_speedup_test.py <dvid_load_sparse>
+"""
+
+import os
+import shutil
+import sys
+import tempfile
+import time
+
+from standin import Node, write_sparse, check_equal
+
+BLOCK_ROWS = 8
+PLANES_PER_ROW = 4
+LATENCY_US = 20000
+
+
+def timed_load(loader, sparse, expected, threads):
+    node = Node()
+    try:
+        start = time.time()
+        node.run([loader, 'server', 'uuid', 'labels', sparse, '5', '--threads', str(threads)],
+                latency_us=LATENCY_US)
+        elapsed = time.time() - start
+        check_equal('%d threads' % threads, node.read_labels(), expected)
+        return elapsed
+    finally:
+        node.close()
+
+
+def main():
+    loader = sys.argv[1]
+    voxels = set()
+    for row in range(BLOCK_ROWS):
+        for z in range(32 * row, 32 * row + PLANES_PER_ROW):
+            for y in range(4):
+                for x in range(8):
+                    voxels.add((x, y, z))
+
+    scratch = tempfile.mkdtemp(prefix='load_sparse_speedup_test_')
+    try:
+        sparse = os.path.join(scratch, 'body.sparse')
+        write_sparse(sparse, voxels)
+        expected = dict.fromkeys(voxels, 5)
+
+        serial = timed_load(loader, sparse, expected, 1)
+        parallel = timed_load(loader, sparse, expected, 8)
+        print('1 thread: %.2fs, 8 threads: %.2fs' % (serial, parallel))
+        if parallel > serial / 2:
+            raise AssertionError('independent chunks were not loaded concurrently')
+    finally:
+        shutil.rmtree(scratch)
+
+
+if __name__ == '__main__':
+    main()
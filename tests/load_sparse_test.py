@@ -0,0 +1,179 @@
+"""
+End to end test of dvid_load_sparse against the libdvid stand-in.
+Each mode loads the same bodies into a volume that already holds
+labels and checks every voxel afterwards.
+
+usage: load_sparse_test.py <dvid_load_sparse>
+"""
+
+import os
+import random
+import shutil
+import sys
+import tempfile
+
+from standin import Node, write_sparse, check_equal
+
+BLOCK = 32
+
+
+def make_body(seed, center, radius, holes):
+    """Voxels of a ball with a fraction of holes, crossing block boundaries and z = 0."""
+    rng = random.Random(seed)
+    cx, cy, cz = center
+    voxels = set()
+    for z in range(cz - radius, cz + radius + 1):
+        for y in range(cy - radius, cy + radius + 1):
+            for x in range(cx - radius, cx + radius + 1):
+                d = (x - cx) ** 2 + (y - cy) ** 2 + (z - cz) ** 2
+                if d <= radius * radius and rng.random() >= holes:
+                    voxels.add((x, y, z))
+    return voxels
+
+
+def block_of(voxel):
+    return tuple(v // BLOCK for v in voxel)
+
+
+def main():
+    loader = sys.argv[1]
+    body1 = make_body(1, (40, 30, 2), 14, 0)
+    body2 = make_body(2, (55, 40, 10), 12, 0.1)
+
+    rng = random.Random(3)
+    existing = {}
+    for x in range(20, 80):
+        for y in range(10, 60):
+            if rng.random() < 0.2:
+                existing[(x, y, rng.randint(-14, 24))] = 7
+
+    scratch = tempfile.mkdtemp(prefix='load_sparse_test_')
+    try:
+        sparse1 = os.path.join(scratch, 'body1.sparse')
+        sparse2 = os.path.join(scratch, 'body2.sparse')
+        write_sparse(sparse1, body1)
+        write_sparse(sparse2, body2)
+        manifest = os.path.join(scratch, 'manifest.txt')
+        with open(manifest, 'w') as f:
+            f.write('%s 11\n%s 12\n' % (sparse1, sparse2))
+
+        def load(name, args, expected, roi=None):
+            node = Node(existing)
+            try:
+                if roi is not None:
+                    with open(node.path('roi-test.txt'), 'w') as f:
+                        for block in sorted(roi):
+                            f.write('%d %d %d\n' % block)
+                node.run([loader, 'server', 'uuid', 'labels'] + args)
+                check_equal(name, node.read_labels(), expected)
+                return node.read_requests()
+            finally:
+                node.close()
+
+        loaded = dict(existing)
+        loaded.update(dict.fromkeys(body1, 11))
+        single = [sparse1, '11']
+
+        load('plane by plane', single, loaded)
+        load('chunks, 4 threads', single + ['--chunk-depth', '32', '--threads', '4'], loaded)
+        load('tiled chunks', single + ['--chunk-depth', '32', '--tile'], loaded)
+        requests = load('covered blocks unread', single + ['--chunk-depth', '32',
+            '--block-size', '4', '--write-only-covered', '--request-cost', '0'], loaded)
+        if not requests.get('put_labels3D', 0) > requests.get('get_labels3D', 0):
+            raise AssertionError('covered blocks were fetched: %s' % requests)
+        load('rle', single + ['--rle', '--rle-endpoint', 'sparsevol',
+            '--rle-max-spans', '7'], loaded)
+        node = Node(existing)
+        try:
+            # no default endpoint: standard label instances take no sparse volumes
+            node.run([loader, 'server', 'uuid', 'labels'] + single + ['--rle'],
+                    expect_success=False)
+            check_equal('rle without endpoint', node.read_labels(), existing)
+        finally:
+            node.close()
+        load('stream', single + ['--stream', '--chunk-depth', '32', '--threads', '2'], loaded)
+
+        background = dict(existing)
+        background.update(dict((v, 11) for v in body1 if v not in existing))
+        load('only if background', single + ['--only-if-background'], background)
+
+        roi = set(block_of(v) for v in body1 if v[2] >= 0 and v[0] < 32)
+        clipped = dict(existing)
+        clipped.update(dict((v, 11) for v in body1 if block_of(v) in roi))
+        load('roi', single + ['--roi', 'test'], clipped, roi)
+
+        # overlapping and repeated [z, y, x0, x1] spans count each block once
+        roi_file = os.path.join(scratch, 'roi.json')
+        with open(roi_file, 'w') as f:
+            f.write('[[0, 0, 0, 1], [0, 0, 1, 2], [0, 0, 1, 1], [0, 1, 0, 0], [0, 1, 0, 0]]')
+        roi_blocks = set([(0, 0, 0), (1, 0, 0), (2, 0, 0), (0, 1, 0)])
+        clipped = dict(existing)
+        clipped.update(dict((v, 11) for v in body1 if block_of(v) in roi_blocks))
+        node = Node(existing)
+        try:
+            output = node.run([loader, 'server', 'uuid', 'labels'] + single +
+                    ['--roi-file', roi_file])
+            if 'ROI has 4 blocks' not in output:
+                raise AssertionError('ROI blocks miscounted:\n' + output)
+            check_equal('roi file', node.read_labels(), clipped)
+        finally:
+            node.close()
+
+        both = dict(loaded)
+        both.update(dict.fromkeys(body2, 12))
+        load('manifest', ['--manifest', manifest, '--chunk-depth', '32', '--threads', '3'], both)
+
+        # conditions see the labels from before the load, not earlier bodies
+        unclaimed = dict(existing)
+        unclaimed.update(dict((v, 11) for v in body1 if v not in existing))
+        unclaimed.update(dict((v, 12) for v in body2 if v not in existing))
+        load('manifest only if background', ['--manifest', manifest, '--only-if-background'],
+                unclaimed)
+
+        # a journal only resumes the load it was written for
+        node = Node(existing)
+        try:
+            journal = node.path('load.journal')
+            args = [loader, 'server', 'uuid', 'labels', sparse1, '11', '--journal', journal]
+            node.run(args + ['--chunk-depth', '32'])
+            output = node.run(args + ['--chunk-depth', '32', '--resume'])
+            if 'Resuming: ' not in output or ' 0 of' in output:
+                raise AssertionError('committed chunks were not skipped:\n' + output)
+            check_equal('resume', node.read_labels(), loaded)
+            # covers the whole body, so only the ROI itself differs
+            with open(node.path('roi-test.txt'), 'w') as f:
+                for block in sorted(set(block_of(v) for v in body1)):
+                    f.write('%d %d %d\n' % block)
+            for changed in (['--only-if-background'], ['--compress'], ['--block-size', '16'],
+                    ['--roi', 'test']):
+                output = node.run(args + ['--chunk-depth', '32', '--resume'] + changed,
+                        expect_success=False)
+                if 'different load plan' not in output:
+                    raise AssertionError('resumed with %s:\n%s' % (changed, output))
+            moved = set((x + 1, y, z) for x, y, z in body1)
+            write_sparse(os.path.join(scratch, 'moved.sparse'), moved)
+            output = node.run([loader, 'server', 'uuid', 'labels',
+                os.path.join(scratch, 'moved.sparse'), '11', '--journal', journal,
+                '--chunk-depth', '32', '--resume'], expect_success=False)
+            if 'different load plan' not in output:
+                raise AssertionError('resumed with other segments:\n' + output)
+            print('journal checks: ok')
+        finally:
+            node.close()
+
+        # undo snapshot restores the labels that were there before
+        node = Node(existing)
+        try:
+            snapshot = node.path('undo.snap')
+            node.run([loader, 'server', 'uuid', 'labels', sparse1, '11', '--undo', snapshot])
+            check_equal('undo load', node.read_labels(), loaded)
+            node.run([loader, 'server', 'uuid', 'labels', '--rollback', snapshot])
+            check_equal('rollback', node.read_labels(), existing)
+        finally:
+            node.close()
+    finally:
+        shutil.rmtree(scratch)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,87 @@
+"""
+End to end test of dvid_load_synapses_graph against the libdvid
+stand-in.  A few synapses between labeled points are loaded with each
+lookup backend and the stored body properties (synapse count, number
+of partners, sorted partners) are checked.
+
+usage: load_synapses_test.py <dvid_load_synapses_graph>
+"""
+
+import json
+import os
+import shutil
+import sys
+import tempfile
+
+from standin import Node, check_equal
+
+LABELS = {
+    (10, 10, 10): 1, (10, 11, 10): 1,
+    (50, 10, 10): 2, (50, 12, 10): 2,
+    (10, 70, 10): 3,
+    (90, 10, 40): 4,
+}
+
+
+def synapse(tbar, partners):
+    return {'T-bar': {'location': list(tbar), 'confidence': 0.9},
+            'partners': [{'location': list(p), 'confidence': 0.5} for p in partners]}
+
+
+def write_synapses(filename, synapses):
+    with open(filename, 'w') as f:
+        json.dump({'data': synapses, 'metadata': {'description': 'synapses'}}, f)
+
+
+def main():
+    loader = sys.argv[1]
+    scratch = tempfile.mkdtemp(prefix='load_synapses_test_')
+    try:
+        synapses = os.path.join(scratch, 'synapses.json')
+        write_synapses(synapses, [
+            synapse((10, 10, 10), [(50, 10, 10), (10, 70, 10)]),
+            synapse((50, 12, 10), [(10, 11, 10), (90, 90, 40)]),   # second point unlabeled
+            synapse((10, 10, 10), [(10, 70, 10)]),
+        ])
+        added = os.path.join(scratch, 'added.json')
+        write_synapses(added, [synapse((50, 10, 10), [(90, 10, 40)])])
+
+        # count, number of partners, partners
+        expected = {
+            1: [3, 2, 2, 3],
+            2: [2, 2, 1, 3],
+            3: [2, 2, 1, 2],
+        }
+        after_delta = dict(expected)
+        after_delta[2] = [3, 3, 1, 3, 4]
+        after_delta[4] = [1, 1, 2]
+
+        def load(name, args, synapse_file=synapses, properties=None, env=None,
+                result=expected):
+            node = Node(LABELS, properties)
+            try:
+                node.run([loader, 'server', 'uuid', 'graph', synapse_file, 'labels'] + args,
+                        env=env)
+                check_equal(name, node.read_properties(), result)
+                return node.read_requests()
+            finally:
+                node.close()
+
+        load('block lookup', [])
+        load('block lookup, uncompressed, 3 workers', ['--no-compress', '--threads', '3',
+            '--read-batch', '1', '--lookup-size', '8'])
+        requests = load('point lookup', ['--lookup', 'points', '--batch-size', '2',
+            '--inflight', '2'])
+        if requests.get('get_labels3D', 0) or not requests.get('get_labels', 0):
+            raise AssertionError('points were not looked up by labels query: %s' % requests)
+        requests = load('conflicting writes retried', ['--vertex-batch', '2'],
+                env={'DVID_STANDIN_CONFLICT_EVERY': '2'})
+        if not requests.get('conflicts', 0):
+            raise AssertionError('no write conflicted: %s' % requests)
+        load('delta', ['--delta'], added, expected, result=after_delta)
+    finally:
+        shutil.rmtree(scratch)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,103 @@
+"""
+Runs a loader against the libdvid stand-in (standin/) and reads back
+the state it leaves behind.  Each Node is a fresh state directory.
+"""
+
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+
+class Node(object):
+    def __init__(self, labels=None, properties=None):
+        self.dir = tempfile.mkdtemp(prefix='dvid_standin_')
+        self.write_labels(labels or {})
+        self.write_properties(properties or {})
+
+    def close(self):
+        shutil.rmtree(self.dir)
+
+    def path(self, name):
+        return os.path.join(self.dir, name)
+
+    def write_labels(self, labels):
+        with open(self.path('labels.txt'), 'w') as f:
+            for (x, y, z), label in sorted(labels.items()):
+                f.write('%d %d %d %d\n' % (x, y, z, label))
+
+    def read_labels(self):
+        labels = {}
+        with open(self.path('labels.txt')) as f:
+            for line in f:
+                x, y, z, label = [int(v) for v in line.split()]
+                labels[(x, y, z)] = label
+        return labels
+
+    def write_properties(self, properties):
+        with open(self.path('properties.txt'), 'w') as f:
+            for vertex, words in sorted(properties.items()):
+                f.write(' '.join(str(v) for v in [vertex] + list(words)) + '\n')
+
+    def read_properties(self):
+        properties = {}
+        with open(self.path('properties.txt')) as f:
+            for line in f:
+                words = [int(v) for v in line.split()]
+                properties[words[0]] = words[1:]
+        return properties
+
+    def read_requests(self):
+        requests = {}
+        if os.path.exists(self.path('requests.txt')):
+            with open(self.path('requests.txt')) as f:
+                for line in f:
+                    kind, count = line.split()
+                    requests[kind] = int(count)
+        return requests
+
+    def run(self, args, latency_us=0, env=None, expect_success=True):
+        """Run a loader with the node as its server; returns its output."""
+        run_env = dict(os.environ)
+        run_env['DVID_STANDIN_DIR'] = self.dir
+        if latency_us:
+            run_env['DVID_STANDIN_LATENCY_US'] = str(latency_us)
+        run_env.update(env or {})
+        proc = subprocess.Popen(args, env=run_env, stdout=subprocess.PIPE,
+                stderr=subprocess.STDOUT, universal_newlines=True)
+        output = proc.communicate()[0]
+        if (proc.returncode == 0) != expect_success:
+            sys.stdout.write(output)
+            raise AssertionError('%s exited with %d' % (' '.join(args), proc.returncode))
+        return output
+
+
+def write_sparse(filename, voxels):
+    """Write the (x, y, z) voxel set as a sparse file of x segments per row."""
+    rows = {}
+    for x, y, z in voxels:
+        rows.setdefault((z, y), []).append(x)
+    with open(filename, 'wb') as f:
+        f.write(struct.pack('<i', len(rows)))
+        for (z, y), xs in sorted(rows.items()):
+            xs.sort()
+            segments = []
+            for x in xs:
+                if segments and segments[-1][1] == x - 1:
+                    segments[-1][1] = x
+                else:
+                    segments.append([x, x])
+            f.write(struct.pack('<iii', z, y, len(segments)))
+            for x1, x2 in segments:
+                f.write(struct.pack('<ii', x1, x2))
+
+
+def check_equal(name, actual, expected):
+    if actual != expected:
+        missing = [k for k in expected if actual.get(k) != expected[k]]
+        extra = [k for k in actual if k not in expected]
+        raise AssertionError('%s: %d entries differ (e.g. %s), %d unexpected (e.g. %s)' % (
+            name, len(missing), missing[:3], len(extra), extra[:3]))
+    print('%s: ok' % name)
@@ -0,0 +1,346 @@
+#include <libdvid/DVIDNodeService.h>
+
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+namespace libdvid {
+
+namespace {
+
+struct VoxelKey {
+    int x, y, z;
+
+    bool operator<(const VoxelKey& other) const
+    {
+        if (z != other.z) {
+            return z < other.z;
+        }
+        if (y != other.y) {
+            return y < other.y;
+        }
+        return x < other.x;
+    }
+};
+
+/*!
+ * Node state shared by all services.  It is loaded when the first
+ * service is created and saved when the process exits.
+*/
+struct NodeState {
+    NodeState() : loaded(false) {}
+    ~NodeState();
+
+    void load();
+
+    boost::mutex mutex;
+    bool loaded;
+    string dir;
+
+    std::map<VoxelKey, uint64> labels;
+    std::map<VertexID, string> properties;
+    std::map<VertexID, VertexTransaction> versions;
+    std::set<VertexID> conflicted;
+    std::map<string, unsigned long long> requests;
+};
+
+NodeState state;
+
+string state_file(string name)
+{
+    return state.dir + "/" + name;
+}
+
+void NodeState::load()
+{
+    loaded = true;
+    const char* env = getenv("DVID_STANDIN_DIR");
+    if (!env) {
+        return;
+    }
+    dir = env;
+
+    std::ifstream label_file(state_file("labels.txt").c_str());
+    VoxelKey key;
+    uint64 label;
+    while (label_file >> key.x >> key.y >> key.z >> label) {
+        labels[key] = label;
+    }
+
+    std::ifstream property_file(state_file("properties.txt").c_str());
+    string line;
+    while (std::getline(property_file, line)) {
+        std::istringstream sstr(line);
+        VertexID id;
+        if (!(sstr >> id)) {
+            continue;
+        }
+        string& data = properties[id];
+        uint64 word;
+        while (sstr >> word) {
+            data.append((const char*) &word, sizeof(word));
+        }
+    }
+}
+
+NodeState::~NodeState()
+{
+    if (dir.empty()) {
+        return;
+    }
+
+    std::ofstream label_file(state_file("labels.txt").c_str());
+    for (std::map<VoxelKey, uint64>::iterator iter = labels.begin();
+            iter != labels.end(); ++iter) {
+        label_file << iter->first.x << " " << iter->first.y << " " <<
+            iter->first.z << " " << iter->second << "\n";
+    }
+
+    std::ofstream property_file(state_file("properties.txt").c_str());
+    for (std::map<VertexID, string>::iterator iter = properties.begin();
+            iter != properties.end(); ++iter) {
+        property_file << iter->first;
+        for (size_t pos = 0; pos + sizeof(uint64) <= iter->second.size();
+                pos += sizeof(uint64)) {
+            uint64 word;
+            memcpy(&word, iter->second.data() + pos, sizeof(word));
+            property_file << " " << word;
+        }
+        property_file << "\n";
+    }
+
+    std::ofstream request_file(state_file("requests.txt").c_str());
+    for (std::map<string, unsigned long long>::iterator iter = requests.begin();
+            iter != requests.end(); ++iter) {
+        request_file << iter->first << " " << iter->second << "\n";
+    }
+}
+
+// every request waits as if sent over the network
+void request_latency()
+{
+    const char* env = getenv("DVID_STANDIN_LATENCY_US");
+    if (env) {
+        usleep(atoi(env));
+    }
+}
+
+// POST <label>/sparsevol/<body>: spans of (x, y, z, length) after a 12 byte header
+void post_sparsevol(uint64 body_id, BinaryDataPtr payload)
+{
+    const string& data = payload->get_data();
+    unsigned int num_spans = 0;
+    if (data.size() >= 12) {
+        memcpy(&num_spans, data.data() + 8, sizeof(num_spans));
+    }
+    if (data.size() < 12 || data[1] != 3 || data[2] != 0 ||
+            data.size() != 12 + 16 * (size_t) num_spans) {
+        throw ErrMsg("malformed sparse volume payload");
+    }
+
+    for (unsigned int i = 0; i < num_spans; ++i) {
+        int span[4];
+        memcpy(span, data.data() + 12 + 16 * (size_t) i, sizeof(span));
+        VoxelKey key = { span[0], span[1], span[2] };
+        for (; key.x < span[0] + span[3]; ++key.x) {
+            state.labels[key] = body_id;
+        }
+    }
+}
+
+// GET <label>/labels: [[x,y,z],...] -> [label,...]
+BinaryDataPtr query_labels(BinaryDataPtr payload)
+{
+    Json::Reader reader;
+    Json::Value points;
+    if (!reader.parse(payload->get_data(), points) || !points.isArray()) {
+        throw ErrMsg("malformed labels query");
+    }
+
+    std::ostringstream sstr;
+    sstr << "[";
+    for (unsigned int i = 0; i < points.size(); ++i) {
+        const Json::Value& point = points[i];
+        if (!point.isArray() || point.size() != 3) {
+            throw ErrMsg("malformed labels query");
+        }
+        VoxelKey key = { point[0u].asInt(), point[1u].asInt(), point[2u].asInt() };
+        std::map<VoxelKey, uint64>::iterator iter = state.labels.find(key);
+        sstr << (i ? "," : "") << ((iter != state.labels.end()) ? iter->second : 0);
+    }
+    sstr << "]";
+    string body = sstr.str();
+    return BinaryData::create_binary_data(body.c_str(), body.size());
+}
+
+}
+
+BinaryDataPtr BinaryData::create_binary_data(const char* data, unsigned int length)
+{
+    BinaryDataPtr binary(new BinaryData);
+    if (data) {
+        binary->data.assign(data, length);
+    }
+    return binary;
+}
+
+DVIDNodeService::DVIDNodeService(string web_addr_, string uuid_)
+{
+    boost::mutex::scoped_lock lock(state.mutex);
+    if (!state.loaded) {
+        state.load();
+    }
+}
+
+Labels3D DVIDNodeService::get_labels3D(string datatype_instance, Dims_t sizes,
+        vector<unsigned int> offset, bool compress, string roi)
+{
+    request_latency();
+    boost::mutex::scoped_lock lock(state.mutex);
+    ++state.requests["get_labels3D"];
+
+    vector<uint64> labels((size_t) sizes[0] * sizes[1] * sizes[2], 0);
+    size_t pos = 0;
+    for (unsigned int z = 0; z < sizes[2]; ++z) {
+        for (unsigned int y = 0; y < sizes[1]; ++y) {
+            for (unsigned int x = 0; x < sizes[0]; ++x, ++pos) {
+                VoxelKey key = { int(offset[0] + x), int(offset[1] + y), int(offset[2] + z) };
+                std::map<VoxelKey, uint64>::iterator iter = state.labels.find(key);
+                if (iter != state.labels.end()) {
+                    labels[pos] = iter->second;
+                }
+            }
+        }
+    }
+    return Labels3D(labels.empty() ? 0 : &labels[0], labels.size() * sizeof(uint64), sizes);
+}
+
+void DVIDNodeService::put_labels3D(string datatype_instance, Labels3D const & volume,
+        vector<unsigned int> offset, bool compress, string roi)
+{
+    request_latency();
+    boost::mutex::scoped_lock lock(state.mutex);
+    ++state.requests["put_labels3D"];
+
+    Dims_t sizes = volume.get_dims();
+    const uint64* labels = volume.get_raw();
+    size_t pos = 0;
+    for (unsigned int z = 0; z < sizes[2]; ++z) {
+        for (unsigned int y = 0; y < sizes[1]; ++y) {
+            for (unsigned int x = 0; x < sizes[0]; ++x, ++pos) {
+                VoxelKey key = { int(offset[0] + x), int(offset[1] + y), int(offset[2] + z) };
+                if (labels[pos]) {
+                    state.labels[key] = labels[pos];
+                } else {
+                    state.labels.erase(key);
+                }
+            }
+        }
+    }
+}
+
+BinaryDataPtr DVIDNodeService::custom_request(string endpoint, BinaryDataPtr payload,
+        ConnectionMethod method, bool compress)
+{
+    request_latency();
+    boost::mutex::scoped_lock lock(state.mutex);
+
+    size_t pos = endpoint.find("/sparsevol/");
+    if (method == POST && pos != string::npos) {
+        ++state.requests["post_sparsevol"];
+        post_sparsevol(strtoull(endpoint.c_str() + pos + 11, 0, 10), payload);
+        return BinaryData::create_binary_data();
+    }
+    if (method == GET && endpoint.size() > 7 &&
+            endpoint.compare(endpoint.size() - 7, 7, "/labels") == 0) {
+        ++state.requests["get_labels"];
+        return query_labels(payload);
+    }
+    throw ErrMsg("endpoint not served by the stand-in: " + endpoint);
+}
+
+void DVIDNodeService::get_roi(string roi_name, vector<BlockXYZ>& blockcoords)
+{
+    request_latency();
+    boost::mutex::scoped_lock lock(state.mutex);
+    ++state.requests["get_roi"];
+
+    std::ifstream fin;
+    if (!state.dir.empty()) {
+        fin.open(state_file("roi-" + roi_name + ".txt").c_str());
+    }
+    if (!fin) {
+        throw ErrMsg("no ROI " + roi_name);
+    }
+    int x, y, z;
+    while (fin >> x >> y >> z) {
+        blockcoords.push_back(BlockXYZ(x, y, z));
+    }
+}
+
+void DVIDNodeService::get_properties(string graph_name, vector<Vertex> vertices,
+        string key, vector<BinaryDataPtr>& properties, VertexTransactions& transactions)
+{
+    request_latency();
+    boost::mutex::scoped_lock lock(state.mutex);
+    ++state.requests["get_properties"];
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        VertexID id = vertices[i].id;
+        transactions[id] = state.versions[id];
+        std::map<VertexID, string>::iterator iter = state.properties.find(id);
+        if (iter == state.properties.end()) {
+            properties.push_back(BinaryData::create_binary_data());
+        } else {
+            properties.push_back(BinaryData::create_binary_data(iter->second.data(),
+                        iter->second.size()));
+        }
+    }
+}
+
+void DVIDNodeService::set_properties(string graph_name, vector<Vertex>& vertices,
+        string key, vector<BinaryDataPtr>& properties, VertexTransactions& transactions,
+        vector<Vertex>& leftover_vertices)
+{
+    request_latency();
+    boost::mutex::scoped_lock lock(state.mutex);
+    ++state.requests["set_properties"];
+
+    if (properties.size() != vertices.size()) {
+        throw ErrMsg("one property is needed per vertex");
+    }
+    const char* env = getenv("DVID_STANDIN_CONFLICT_EVERY");
+    VertexID conflict_every = env ? strtoull(env, 0, 10) : 0;
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        VertexID id = vertices[i].id;
+        VertexTransactions::iterator transaction = transactions.find(id);
+        bool conflict = (transaction == transactions.end()) ||
+            (transaction->second != state.versions[id]);
+
+        // another writer got there first
+        if (!conflict && conflict_every && (id % conflict_every == 0) &&
+                state.conflicted.insert(id).second) {
+            ++state.versions[id];
+            conflict = true;
+        }
+        if (conflict) {
+            ++state.requests["conflicts"];
+            leftover_vertices.push_back(vertices[i]);
+            continue;
+        }
+
+        state.properties[id] = properties[i]->get_data();
+        ++state.versions[id];
+    }
+}
+
+}
@@ -0,0 +1,136 @@
+/*!
+ * Stand-in for the part of libdvid used by the loaders, so they can
+ * be run end to end without a DVID server.  The declarations match
+ * libdvid's; the node is an in-memory label volume, vertex property
+ * store and ROI list shared by every DVIDNodeService in the process.
+ *
+ * The state is read from and saved to the directory named by
+ * DVID_STANDIN_DIR (nothing is read or saved when it is not set):
+ *
+ *   labels.txt       "x y z label" per non-zero voxel
+ *   properties.txt   "vertex word..." per vertex property, as uint64 words
+ *   roi-<name>.txt   "x y z" per block of the ROI <name> (read only)
+ *   requests.txt     requests served by kind (written only)
+ *
+ * DVID_STANDIN_LATENCY_US delays every request by that many
+ * microseconds, outside any lock, so concurrent requests overlap as
+ * they would on a server.  DVID_STANDIN_CONFLICT_EVERY=N makes the
+ * first write of every vertex whose id is a multiple of N fail with
+ * a transaction conflict.
+ *
+ * Besides label subvolumes, two custom requests are served: POST
+ * <label>/sparsevol/<body> with an RLE payload and GET <label>/labels
+ * with a JSON list of [x,y,z] points.
+*/
+
+#ifndef DVIDSTANDIN_DVIDNODESERVICE_H
+#define DVIDSTANDIN_DVIDNODESERVICE_H
+
+#include <json/json.h>
+#include <boost/shared_ptr.hpp>
+#include <tr1/unordered_map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace libdvid {
+
+typedef unsigned long long uint64;
+typedef unsigned long long VertexID;
+typedef unsigned long long VertexTransaction;
+typedef std::vector<unsigned int> Dims_t;
+typedef std::tr1::unordered_map<VertexID, VertexTransaction> VertexTransactions;
+
+enum ConnectionMethod { HEAD, GET, POST, PUT, DELETE };
+
+//! raised for requests the stand-in cannot serve
+class ErrMsg : public std::runtime_error {
+  public:
+    explicit ErrMsg(std::string msg) : std::runtime_error(msg) {}
+};
+
+class BinaryData;
+typedef boost::shared_ptr<BinaryData> BinaryDataPtr;
+
+class BinaryData {
+  public:
+    static BinaryDataPtr create_binary_data(const char* data = 0, unsigned int length = 0);
+
+    const unsigned char* get_raw() const
+    {
+        return (const unsigned char*) data.data();
+    }
+    std::string& get_data()
+    {
+        return data;
+    }
+    size_t length() const
+    {
+        return data.size();
+    }
+
+  private:
+    std::string data;
+};
+
+//! label subvolume, x fastest
+class Labels3D {
+  public:
+    Labels3D() {}
+    //! \param length size of array in bytes
+    Labels3D(const uint64* array, unsigned int length, Dims_t& dims_) :
+        labels(new std::vector<uint64>(array, array + length / sizeof(uint64))),
+        dims(dims_) {}
+
+    const uint64* get_raw() const
+    {
+        return labels->empty() ? 0 : &(*labels)[0];
+    }
+    Dims_t get_dims() const
+    {
+        return dims;
+    }
+
+  private:
+    boost::shared_ptr<std::vector<uint64> > labels;
+    Dims_t dims;
+};
+
+struct Vertex {
+    Vertex(VertexID id_, double weight_) : id(id_), weight(weight_) {}
+    VertexID id;
+    double weight;
+};
+
+struct BlockXYZ {
+    BlockXYZ(int x_, int y_, int z_) : x(x_), y(y_), z(z_) {}
+    int x, y, z;
+};
+
+class DVIDNodeService {
+  public:
+    DVIDNodeService(std::string web_addr_, std::string uuid_);
+
+    Labels3D get_labels3D(std::string datatype_instance, Dims_t sizes,
+            std::vector<unsigned int> offset, bool compress = true, std::string roi = "");
+
+    void put_labels3D(std::string datatype_instance, Labels3D const & volume,
+            std::vector<unsigned int> offset, bool compress = true, std::string roi = "");
+
+    BinaryDataPtr custom_request(std::string endpoint, BinaryDataPtr payload,
+            ConnectionMethod method, bool compress = false);
+
+    void get_roi(std::string roi_name, std::vector<BlockXYZ>& blockcoords);
+
+    void get_properties(std::string graph_name, std::vector<Vertex> vertices,
+            std::string key, std::vector<BinaryDataPtr>& properties,
+            VertexTransactions& transactions);
+
+    void set_properties(std::string graph_name, std::vector<Vertex>& vertices,
+            std::string key, std::vector<BinaryDataPtr>& properties,
+            VertexTransactions& transactions, std::vector<Vertex>& leftover_vertices);
+};
+
+}
+
+#endif